@@ -27,6 +27,7 @@
 #include "vnr-message-area.h"
 #include "vnr-file.h"
 #include "vnr-tools.h"
+#include "uni-exiv2.hpp"
 
 #define PIXMAP_DIR        PACKAGE_DATA_DIR"/viewnior/pixmaps/"
 
@@ -80,6 +81,9 @@ main (int argc, char *argv[])
 
     gtk_icon_theme_append_search_path(gtk_icon_theme_get_default(), PIXMAP_DIR);
 
+    /* Images get decoded, and their metadata read, on worker threads */
+    uni_exiv2_initialize();
+
     window = vnr_window_new ();
     gtk_window_set_default_size (window, 480, 300);
     gtk_window_set_position (window, GTK_WIN_POS_CENTER);
@@ -285,6 +285,37 @@ uni_anim_view_set_anim (UniAnimView * aview, GdkPixbufAnimation * anim)
 }
 
 
+/**
+ * uni_anim_view_replace_anim:
+ * @aview: a #UniAnimView
+ * @anim: a static #GdkPixbufAnimation
+ * @orientation: the EXIF orientation to show @anim in
+ *
+ * Replaces the current static image with @anim, which shows the same
+ * image at another resolution. The view keeps its zoom and scroll
+ * position, see uni_image_view_replace_pixbuf().
+ **/
+void
+uni_anim_view_replace_anim (UniAnimView * aview, GdkPixbufAnimation * anim,
+                            int orientation)
+{
+    g_return_if_fail (gdk_pixbuf_animation_is_static_image (anim));
+
+    g_object_ref (anim);
+    if (aview->anim)
+        g_object_unref (aview->anim);
+    aview->anim = anim;
+
+    if (aview->iter)
+        g_object_unref (aview->iter);
+    g_get_current_time (&aview->time);
+    aview->iter = gdk_pixbuf_animation_get_iter (aview->anim, &aview->time);
+
+    uni_image_view_replace_pixbuf (UNI_IMAGE_VIEW (aview),
+                                   gdk_pixbuf_animation_get_static_image (anim),
+                                   orientation);
+}
+
 /* No conversion from GdkPixbuf to GdkPixbufAnim can be made
  * directly using the current API, so this makes a static
  * GdkPixbufAnimation and updates the UniAnimView */
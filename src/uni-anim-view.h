@@ -79,6 +79,10 @@ gboolean    uni_anim_view_set_anim          (UniAnimView * aview,
 void        uni_anim_view_set_static        (UniAnimView * aview,
                                              GdkPixbuf *anim);
 
+void        uni_anim_view_replace_anim      (UniAnimView * aview,
+                                             GdkPixbufAnimation * anim,
+                                             int orientation);
+
 void        uni_anim_view_set_is_playing    (UniAnimView * aview,
                                              gboolean playing);
 
@@ -22,90 +22,80 @@
 
 #include "uni-cache.h"
 #include "uni-utils.h"
-#include <string.h>
+#include "uni-scale.h"
+#include <math.h>
 
-static gboolean
-uni_rectangle_contains_rect (GdkRectangle r1, GdkRectangle r2)
-{
-    return
-        r1.x <= r2.x &&
-        r1.y <= r2.y &&
-        (r2.x + r2.width) <= (r1.x + r1.width) &&
-        (r2.y + r2.height) <= (r1.y + r1.height);
-}
+/* Width and height of the tiles the scaled image is cut into */
+#define UNI_DRAW_TILE_SIZE 256
 
-static void
-uni_pixbuf_copy_area_intact (GdkPixbuf * src,
-                             int src_x,
-                             int src_y,
-                             int width,
-                             int height,
-                             GdkPixbuf * dst, int dst_x, int dst_y)
+/* Server memory the tiles of one cache may take */
+#define UNI_DRAW_CACHE_BUDGET (64 * 1024 * 1024)
+
+/* One tile of the scaled image. The first fields are the key. */
+typedef struct {
+    GdkPixbuf *pixbuf;
+    UniTiledSource *source;
+    gdouble zoom;
+    GdkInterpType interp;
+    int orientation;
+    int col;
+    int row;
+
+    GdkPixmap *pixmap;
+    gsize size;
+} UniDrawTile;
+
+static guint
+uni_draw_tile_hash (gconstpointer key)
 {
-    int y;
-    if (src_x == dst_x && src_y == dst_y && src == dst)
-        return;
+    const UniDrawTile *tile = key;
 
-    int src_stride = gdk_pixbuf_get_rowstride (src);
-    int dst_stride = gdk_pixbuf_get_rowstride (dst);
-    int chans = gdk_pixbuf_get_n_channels (src);
+    return g_direct_hash (tile->pixbuf)
+        ^ g_double_hash (&tile->zoom)
+        ^ ((guint) tile->col * 73856093u)
+        ^ ((guint) tile->row * 19349663u);
+}
 
-    int linelen = width * chans;
+static gboolean
+uni_draw_tile_equal (gconstpointer a, gconstpointer b)
+{
+    const UniDrawTile *t1 = a;
+    const UniDrawTile *t2 = b;
 
-    guchar *src_base = gdk_pixbuf_get_pixels (src);
-    guchar *dst_base = gdk_pixbuf_get_pixels (dst);
+    return t1->pixbuf == t2->pixbuf &&
+        t1->source == t2->source &&
+        t1->zoom == t2->zoom &&
+        t1->interp == t2->interp &&
+        t1->orientation == t2->orientation &&
+        t1->col == t2->col && t1->row == t2->row;
+}
 
-    int src_y_ofs = src_y * src_stride;
-    int dst_y_ofs = dst_y * dst_stride;
-    if (dst_y > src_y)
-    {
-        src_y_ofs = (src_y + height - 1) * src_stride;
-        dst_y_ofs = (dst_y + height - 1) * dst_stride;
-        src_stride = -src_stride;
-        dst_stride = -dst_stride;
-    }
-    guchar *src_ofs = src_base + src_y_ofs + src_x * chans;
-    guchar *dst_ofs = dst_base + dst_y_ofs + dst_x * chans;
+static void
+uni_draw_tile_free (UniDrawTile * tile)
+{
+    g_object_unref (tile->pixbuf);
+    if (tile->source)
+        uni_tiled_source_unref (tile->source);
+    g_object_unref (tile->pixmap);
+    g_free (tile);
+}
 
-    void (*copy_func) (void *, void *, size_t) = (void *) memcpy;
-    if (dst_x > src_x)
-        copy_func = (void *) memmove;
+static void
+uni_pixbuf_draw_cache_remove_link (UniPixbufDrawCache * cache, GList * link)
+{
+    UniDrawTile *tile = link->data;
 
-    for (y = 0; y < height; y++)
-    {
-        copy_func (dst_ofs, src_ofs, linelen);
-        src_ofs += src_stride;
-        dst_ofs += dst_stride;
-    }
+    g_hash_table_remove (cache->tiles, tile);
+    g_queue_delete_link (cache->lru, link);
+    cache->used -= tile->size;
+    uni_draw_tile_free (tile);
 }
 
-/**
- * uni_pixbuf_draw_cache_get_method:
- * @old: the last draw options used
- * @new_: the current draw options
- * @returns: the best draw method to use to draw
- *
- * Gets the fastest method to draw the specified draw options.
- * @last_opts is assumed to be the last #PixbufDrawOpts used and
- * @new_opts is the one to use this time.
- **/
-UniPixbufDrawMethod
-uni_pixbuf_draw_cache_get_method (UniPixbufDrawOpts * old,
-                                  UniPixbufDrawOpts * new_)
+static void
+uni_pixbuf_draw_cache_flush (UniPixbufDrawCache * cache)
 {
-    if (new_->zoom != old->zoom ||
-        new_->interp != old->interp || new_->pixbuf != old->pixbuf)
-    {
-        return UNI_PIXBUF_DRAW_METHOD_SCALE;
-    }
-    else if (uni_rectangle_contains_rect (old->zoom_rect, new_->zoom_rect))
-    {
-        return UNI_PIXBUF_DRAW_METHOD_CONTAINS;
-    }
-    else
-    {
-        return UNI_PIXBUF_DRAW_METHOD_SCROLL;
-    }
+    while (cache->lru->tail)
+        uni_pixbuf_draw_cache_remove_link (cache, cache->lru->tail);
 }
 
 /**
@@ -118,14 +108,14 @@ UniPixbufDrawCache *
 uni_pixbuf_draw_cache_new ()
 {
     UniPixbufDrawCache *cache = g_new0 (UniPixbufDrawCache, 1);
-    cache->last_pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8, 1, 1);
-    cache->check_size = 16;
-    cache->old = (UniPixbufDrawOpts)
-    {
-        0,
-        {
-        0, 0, 0, 0}
-    , 0, 0, GDK_INTERP_NEAREST, cache->last_pixbuf};
+    cache->tiles = g_hash_table_new (uni_draw_tile_hash,
+                                     uni_draw_tile_equal);
+    cache->lru = g_queue_new ();
+    cache->used = 0;
+    cache->budget = UNI_DRAW_CACHE_BUDGET;
+    cache->scratch = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8,
+                                     UNI_DRAW_TILE_SIZE, UNI_DRAW_TILE_SIZE);
+    cache->gc = NULL;
     return cache;
 }
 
@@ -138,7 +128,12 @@ uni_pixbuf_draw_cache_new ()
 void
 uni_pixbuf_draw_cache_free (UniPixbufDrawCache * cache)
 {
-    g_object_unref (cache->last_pixbuf);
+    uni_pixbuf_draw_cache_flush (cache);
+    g_hash_table_destroy (cache->tiles);
+    g_queue_free (cache->lru);
+    g_object_unref (cache->scratch);
+    if (cache->gc)
+        g_object_unref (cache->gc);
     g_free (cache);
 }
 
@@ -146,13 +141,12 @@ uni_pixbuf_draw_cache_free (UniPixbufDrawCache * cache)
  * uni_pixbuf_draw_cache_invalidate:
  * @cache: a #UniPixbufDrawCache
  *
- * Force the pixbuf draw cache to scale the pixbuf at the next draw.
+ * Drops all cached tiles, so that the pixbuf is scaled again at the
+ * next draw.
  *
- * UniPixbufDrawCache tries to minimize the number of scale operations
- * needed by caching the last drawn pixbuf. It would be inefficient to
- * check the individual pixels inside the pixbuf so it assumes that if
- * the memory address of the pixbuf has not changed, then the cache is
- * good to use.
+ * Tiles are looked up by the memory address of the pixbuf they were
+ * scaled from, so the cache assumes that as long as the pixbuf is the
+ * same object, its tiles are good to use.
  *
  * However, when the image data is modified, this assumtion breaks,
  * which is why this method must be used to tell draw cache about it.
@@ -160,99 +154,275 @@ uni_pixbuf_draw_cache_free (UniPixbufDrawCache * cache)
 void
 uni_pixbuf_draw_cache_invalidate (UniPixbufDrawCache * cache)
 {
-    /* Set the cached zoom to a bogus value, to force a
-       DRAW_FLAGS_SCALE. */
-    cache->old.zoom = -1234.0;
+    uni_pixbuf_draw_cache_flush (cache);
+}
+
+/* Samples an area of a turned image. The matching area of the pixbuf
+ * as stored is scaled into a buffer the size of the area, which is then
+ * turned around and blended into @dst. Only ever the visible part of
+ * the image gets turned, never the whole pixbuf. */
+static void
+uni_pixbuf_draw_cache_sample_oriented (UniPixbufDrawOpts * opts,
+                                       GdkPixbuf * dst,
+                                       int dst_x,
+                                       int dst_y,
+                                       int dst_width,
+                                       int dst_height,
+                                       gdouble offset_x,
+                                       gdouble offset_y,
+                                       int check_x, int check_y)
+{
+    gdouble zoomed_width = gdk_pixbuf_get_width (opts->pixbuf) * opts->zoom;
+    gdouble zoomed_height = gdk_pixbuf_get_height (opts->pixbuf) * opts->zoom;
+    gdouble x = dst_x - offset_x;
+    gdouble y = dst_y - offset_y;
+    gdouble src_x, src_y;
+    int src_width = dst_width;
+    int src_height = dst_height;
+    GdkPixbuf *tmp, *turned;
+
+    /* Map the area back onto the pixbuf as stored */
+    switch (opts->orientation)
+    {
+    case 2:
+        src_x = zoomed_width - x - dst_width;
+        src_y = y;
+        break;
+    case 3:
+        src_x = zoomed_width - x - dst_width;
+        src_y = zoomed_height - y - dst_height;
+        break;
+    case 4:
+        src_x = x;
+        src_y = zoomed_height - y - dst_height;
+        break;
+    case 5:
+        src_x = y;
+        src_y = x;
+        break;
+    case 6:
+        src_x = y;
+        src_y = zoomed_height - x - dst_width;
+        break;
+    case 7:
+        src_x = zoomed_width - y - dst_height;
+        src_y = zoomed_height - x - dst_width;
+        break;
+    default:
+        src_x = zoomed_width - y - dst_height;
+        src_y = x;
+        break;
+    }
+
+    if (UNI_ORIENTATION_IS_TRANSPOSED (opts->orientation))
+    {
+        src_width = dst_height;
+        src_height = dst_width;
+    }
+
+    tmp = gdk_pixbuf_new (GDK_COLORSPACE_RGB,
+                          gdk_pixbuf_get_has_alpha (opts->pixbuf), 8,
+                          src_width, src_height);
+    if (tmp == NULL)
+        return;
+
+    gdk_pixbuf_scale (opts->pixbuf, tmp, 0, 0, src_width, src_height,
+                      -src_x, -src_y, opts->zoom, opts->zoom, opts->interp);
+
+    turned = uni_pixbuf_apply_orientation (tmp, opts->orientation);
+    g_object_unref (tmp);
+    if (turned == NULL)
+        return;
+
+    uni_pixbuf_scale_blend (turned, dst,
+                            dst_x, dst_y, dst_width, dst_height,
+                            dst_x, dst_y, 1.0,
+                            GDK_INTERP_NEAREST, check_x, check_y);
+    g_object_unref (turned);
+}
+
+/* Samples an area of the image into @dst, from the tiled source if the
+ * pixbuf lacks the detail. */
+static void
+uni_pixbuf_draw_cache_sample (UniPixbufDrawOpts * opts,
+                              GdkPixbuf * dst,
+                              int dst_x,
+                              int dst_y,
+                              int dst_width,
+                              int dst_height,
+                              gdouble offset_x,
+                              gdouble offset_y, int check_x, int check_y)
+{
+    if (opts->orientation != 1 && opts->source == NULL)
+        uni_pixbuf_draw_cache_sample_oriented (opts, dst,
+                                               dst_x, dst_y,
+                                               dst_width, dst_height,
+                                               offset_x, offset_y,
+                                               check_x, check_y);
+    else if (opts->source != NULL && opts->zoom > 1.0)
+    {
+        gdouble zoom = opts->zoom * gdk_pixbuf_get_width (opts->pixbuf)
+            / opts->source->width;
+        uni_tiled_source_scale_blend (opts->source, dst,
+                                      dst_x, dst_y, dst_width, dst_height,
+                                      offset_x, offset_y, zoom,
+                                      opts->interp, check_x, check_y);
+    }
+    else
+        uni_pixbuf_scale_blend (opts->pixbuf, dst,
+                                dst_x, dst_y, dst_width, dst_height,
+                                offset_x, offset_y, opts->zoom,
+                                opts->interp, check_x, check_y);
 }
 
-static GdkPixbuf *
-uni_pixbuf_draw_cache_scroll_intersection (GdkPixbuf * pixbuf,
-                                           int new_width,
-                                           int new_height,
-                                           int src_x,
-                                           int src_y,
-                                           int inter_width,
-                                           int inter_height,
-                                           int dst_x, int dst_y)
+
+/* Size of the image as drawn, rounded up, plus a pixel of slack for
+ * the rounding of mipmap levels. Tiles are cut off there. */
+static void
+uni_pixbuf_draw_cache_get_extent (UniPixbufDrawOpts * opts,
+                                  int *width, int *height)
 {
-    int last_width = gdk_pixbuf_get_width (pixbuf);
-    int last_height = gdk_pixbuf_get_height (pixbuf);
+    gdouble w = gdk_pixbuf_get_width (opts->pixbuf) * opts->zoom;
+    gdouble h = gdk_pixbuf_get_height (opts->pixbuf) * opts->zoom;
 
-    int width = MAX (last_width, new_width);
-    int height = MAX (last_height, new_height);
-    if (width > last_width || height > last_height)
+    if (UNI_ORIENTATION_IS_TRANSPOSED (opts->orientation))
     {
-        GdkColorspace cs = gdk_pixbuf_get_colorspace (pixbuf);
-        int bps = gdk_pixbuf_get_bits_per_sample (pixbuf);
-        gboolean alpha = gdk_pixbuf_get_has_alpha (pixbuf);
-        GdkPixbuf *tmp = gdk_pixbuf_new (cs, alpha, bps, width, height);
-
-        uni_pixbuf_copy_area_intact (pixbuf,
-                                     src_x, src_y,
-                                     inter_width, inter_height,
-                                     tmp, dst_x, dst_y);
-        g_object_unref (pixbuf);
-        return tmp;
+        gdouble tmp = w;
+        w = h;
+        h = tmp;
     }
-    uni_pixbuf_copy_area_intact (pixbuf,
-                                 src_x, src_y,
-                                 inter_width, inter_height,
-                                 pixbuf, dst_x, dst_y);
-    return pixbuf;
+    *width = (int) ceil (w) + 1;
+    *height = (int) ceil (h) + 1;
 }
 
 /**
- * uni_pixbuf_draw_cache_intersect_draw:
+ * uni_pixbuf_draw_cache_get_tile:
+ * @returns: tile (@col, @row) of the image as @opts draws it, owned
+ *   by @cache.
  *
- * Updates the cache by first scrolling the still valid area in the
- * cache. Then the newly exposed areas in the cache is sampled from
- * the pixbuf.
+ * Scales and uploads the tile if it isn't cached yet. The least
+ * recently used tiles are dropped to make room for it.
  **/
-static void
-uni_pixbuf_draw_cache_intersect_draw (UniPixbufDrawCache * cache,
-                                      UniPixbufDrawOpts * opts,
-                                      GdkDrawable * drawable)
+static UniDrawTile *
+uni_pixbuf_draw_cache_get_tile (UniPixbufDrawCache * cache,
+                                UniPixbufDrawOpts * opts,
+                                GdkDrawable * drawable, int col, int row)
 {
-    GdkRectangle this = opts->zoom_rect;
-    GdkRectangle old_rect = cache->old.zoom_rect;
-    int n;
-
-    /* If there is no intersection, we have to scale the whole area
-       from the source pixbuf. */
-    GdkRectangle inter;
-    GdkRectangle around[4] = {
-        this,
-        {0, 0, 0, 0},
-        {0, 0, 0, 0},
-        {0, 0, 0, 0}
+    UniDrawTile key = {
+        opts->pixbuf, opts->source, opts->zoom, opts->interp,
+        opts->orientation, col, row, NULL, 0
     };
-    if (gdk_rectangle_intersect (&old_rect, &this, &inter))
-        uni_rectangle_get_rects_around (&this, &inter, around);
-
-    cache->last_pixbuf =
-        uni_pixbuf_draw_cache_scroll_intersection (cache->last_pixbuf,
-                                                   this.width,
-                                                   this.height,
-                                                   inter.x - old_rect.x,
-                                                   inter.y - old_rect.y,
-                                                   inter.width,
-                                                   inter.height,
-                                                   around[1].width,
-                                                   around[0].height);
-
-    for (n = 0; n < 4; n++)
+    int x = col * UNI_DRAW_TILE_SIZE;
+    int y = row * UNI_DRAW_TILE_SIZE;
+    int extent_width, extent_height, width, height;
+    UniDrawTile *tile;
+    GList *link;
+
+    link = g_hash_table_lookup (cache->tiles, &key);
+    if (link)
     {
-        if (!around[n].width || !around[n].height)
-            continue;
-        uni_pixbuf_scale_blend (opts->pixbuf,
-                                cache->last_pixbuf,
-                                around[n].x - this.x,
-                                around[n].y - this.y,
-                                around[n].width, around[n].height,
-                                -this.x, -this.y,
-                                opts->zoom,
-                                opts->interp, around[n].x, around[n].y);
+        g_queue_unlink (cache->lru, link);
+        g_queue_push_head_link (cache->lru, link);
+        return link->data;
     }
+
+    uni_pixbuf_draw_cache_get_extent (opts, &extent_width, &extent_height);
+    width = CLAMP (extent_width - x, 1, UNI_DRAW_TILE_SIZE);
+    height = CLAMP (extent_height - y, 1, UNI_DRAW_TILE_SIZE);
+
+    uni_pixbuf_draw_cache_sample (opts, cache->scratch,
+                                  0, 0, width, height,
+                                  (gdouble) -x, (gdouble) -y, x, y);
+
+    tile = g_new (UniDrawTile, 1);
+    *tile = key;
+    g_object_ref (tile->pixbuf);
+    if (tile->source)
+        uni_tiled_source_ref (tile->source);
+    tile->pixmap = gdk_pixmap_new (drawable, width, height, -1);
+    tile->size = (gsize) width * height * 4;
+    gdk_draw_pixbuf (tile->pixmap, cache->gc, cache->scratch,
+                     0, 0, 0, 0, width, height,
+                     GDK_RGB_DITHER_MAX, x, y);
+
+    while (cache->lru->tail && cache->used + tile->size > cache->budget)
+        uni_pixbuf_draw_cache_remove_link (cache, cache->lru->tail);
+
+    g_queue_push_head (cache->lru, tile);
+    g_hash_table_insert (cache->tiles, tile, cache->lru->head);
+    cache->used += tile->size;
+    return tile;
+}
+
+/**
+ * uni_pixbuf_draw_cache_draw_unscaled:
+ * @returns: %TRUE if the area was drawn, %FALSE if it must go through
+ *   the tiles.
+ *
+ * Draws the area straight from the pixbuf when it is shown at 1:1 as
+ * stored, which is how images are inspected in detail. There is
+ * nothing to scale then, so caching tiles would only copy every pixel
+ * once more. Opaque pixbufs are handed to GDK as they are; transparent
+ * ones are put over the checkerboard in pieces the size of the scratch
+ * buffer, covering only the area asked for.
+ **/
+static gboolean
+uni_pixbuf_draw_cache_draw_unscaled (UniPixbufDrawCache * cache,
+                                     UniPixbufDrawOpts * opts,
+                                     GdkDrawable * drawable)
+{
+    GdkRectangle this;
+    GdkRectangle bounds = {
+        0, 0,
+        gdk_pixbuf_get_width (opts->pixbuf),
+        gdk_pixbuf_get_height (opts->pixbuf)
+    };
+    int x, y;
+
+    if (opts->zoom != 1.0 || opts->orientation != 1)
+        return FALSE;
+
+    if (!gdk_rectangle_intersect (&opts->zoom_rect, &bounds, &this))
+        return TRUE;
+
+    if (!gdk_pixbuf_get_has_alpha (opts->pixbuf))
+    {
+        gdk_draw_pixbuf (drawable, cache->gc, opts->pixbuf,
+                         this.x, this.y,
+                         opts->widget_x + this.x - opts->zoom_rect.x,
+                         opts->widget_y + this.y - opts->zoom_rect.y,
+                         this.width, this.height,
+                         GDK_RGB_DITHER_MAX, this.x, this.y);
+        return TRUE;
+    }
+
+    for (y = this.y; y < this.y + this.height; y += UNI_DRAW_TILE_SIZE)
+    {
+        for (x = this.x; x < this.x + this.width; x += UNI_DRAW_TILE_SIZE)
+        {
+            int width = MIN (UNI_DRAW_TILE_SIZE, this.x + this.width - x);
+            int height = MIN (UNI_DRAW_TILE_SIZE, this.y + this.height - y);
+            GdkPixbuf *piece;
+            gboolean blended;
+
+            piece = gdk_pixbuf_new_subpixbuf (opts->pixbuf,
+                                              x, y, width, height);
+            blended = uni_pixbuf_blend_checks (piece, cache->scratch,
+                                               0, 0, x, y);
+            g_object_unref (piece);
+
+            /* Only formats the tiles can handle are left */
+            if (!blended)
+                return FALSE;
+
+            gdk_draw_pixbuf (drawable, cache->gc, cache->scratch,
+                             0, 0,
+                             opts->widget_x + x - opts->zoom_rect.x,
+                             opts->widget_y + y - opts->zoom_rect.y,
+                             width, height, GDK_RGB_DITHER_MAX, x, y);
+        }
+    }
+    return TRUE;
 }
 
 /**
@@ -262,58 +432,61 @@ uni_pixbuf_draw_cache_intersect_draw (UniPixbufDrawCache * cache,
  * @drawable: a #GdkDrawable to draw on
  *
  * Redraws the area specified in the pixbuf draw options in an
- * efficient way by using caching.
+ * efficient way by using caching, or by drawing the pixbuf directly
+ * at 1:1.
  **/
 void
 uni_pixbuf_draw_cache_draw (UniPixbufDrawCache * cache,
                             UniPixbufDrawOpts * opts, GdkDrawable * drawable)
 {
     GdkRectangle this = opts->zoom_rect;
-    UniPixbufDrawMethod method =
-        uni_pixbuf_draw_cache_get_method (&cache->old, opts);
-    int deltax = 0;
-    int deltay = 0;
-    if (method == UNI_PIXBUF_DRAW_METHOD_CONTAINS)
-    {
-        deltax = this.x - cache->old.zoom_rect.x;
-        deltay = this.y - cache->old.zoom_rect.y;
-    }
-    else if (method == UNI_PIXBUF_DRAW_METHOD_SCROLL)
+    int col0, row0, col1, row1, col, row;
+
+    /* Pixmaps and the GC only work on drawables like the ones they
+       were made for. */
+    if (cache->gc == NULL ||
+        gdk_drawable_get_depth (drawable) != cache->depth ||
+        gdk_drawable_get_screen (drawable) != cache->screen)
     {
-        uni_pixbuf_draw_cache_intersect_draw (cache, opts, drawable);
+        uni_pixbuf_draw_cache_flush (cache);
+        if (cache->gc)
+            g_object_unref (cache->gc);
+        cache->gc = gdk_gc_new (drawable);
+        cache->depth = gdk_drawable_get_depth (drawable);
+        cache->screen = gdk_drawable_get_screen (drawable);
     }
-    else if (method == UNI_PIXBUF_DRAW_METHOD_SCALE)
+
+    if (uni_pixbuf_draw_cache_draw_unscaled (cache, opts, drawable))
+        return;
+
+    col0 = this.x / UNI_DRAW_TILE_SIZE;
+    row0 = this.y / UNI_DRAW_TILE_SIZE;
+    col1 = (this.x + this.width - 1) / UNI_DRAW_TILE_SIZE;
+    row1 = (this.y + this.height - 1) / UNI_DRAW_TILE_SIZE;
+
+    for (row = row0; row <= row1; row++)
     {
-        int last_width = gdk_pixbuf_get_width (cache->last_pixbuf);
-        int last_height = gdk_pixbuf_get_height (cache->last_pixbuf);
-        GdkColorspace new_cs = gdk_pixbuf_get_colorspace (opts->pixbuf);
-        GdkColorspace last_cs =
-            gdk_pixbuf_get_colorspace (cache->last_pixbuf);
-        int new_bps = gdk_pixbuf_get_bits_per_sample (opts->pixbuf);
-        int last_bps = gdk_pixbuf_get_bits_per_sample (cache->last_pixbuf);
-
-        if (this.width > last_width || this.height > last_height ||
-            new_cs != last_cs || new_bps != last_bps)
+        for (col = col0; col <= col1; col++)
         {
-            g_object_unref (cache->last_pixbuf);
-            cache->last_pixbuf = gdk_pixbuf_new (new_cs, FALSE, new_bps,
-                                                 this.width, this.height);
-        }
+            UniDrawTile *tile;
+            GdkRectangle area;
+            GdkRectangle tile_area = {
+                col * UNI_DRAW_TILE_SIZE, row * UNI_DRAW_TILE_SIZE,
+                UNI_DRAW_TILE_SIZE, UNI_DRAW_TILE_SIZE
+            };
+
+            tile = uni_pixbuf_draw_cache_get_tile (cache, opts, drawable,
+                                                   col, row);
+            gdk_drawable_get_size (tile->pixmap,
+                                   &tile_area.width, &tile_area.height);
+            if (!gdk_rectangle_intersect (&tile_area, &this, &area))
+                continue;
 
-        uni_pixbuf_scale_blend (opts->pixbuf,
-                                cache->last_pixbuf,
-                                0, 0,
-                                this.width, this.height,
-                                (double) -this.x, (double) -this.y,
-                                opts->zoom, opts->interp, this.x, this.y);
+            gdk_draw_drawable (drawable, cache->gc, tile->pixmap,
+                               area.x - tile_area.x, area.y - tile_area.y,
+                               opts->widget_x + area.x - this.x,
+                               opts->widget_y + area.y - this.y,
+                               area.width, area.height);
+        }
     }
-    gdk_draw_pixbuf (drawable,
-                     NULL,
-                     cache->last_pixbuf,
-                     deltax, deltay,
-                     opts->widget_x, opts->widget_y,
-                     this.width, this.height,
-                     GDK_RGB_DITHER_MAX, opts->widget_x, opts->widget_y);
-    if (method != UNI_PIXBUF_DRAW_METHOD_CONTAINS)
-        cache->old = *opts;
 }
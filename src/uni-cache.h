@@ -24,16 +24,11 @@
 #define __UNI_CACHE_H__
 
 #include <gdk/gdk.h>
+#include "uni-tiled-source.h"
 
 typedef struct _UniPixbufDrawOpts UniPixbufDrawOpts;
 typedef struct _UniPixbufDrawCache UniPixbufDrawCache;
 
-typedef enum {
-    UNI_PIXBUF_DRAW_METHOD_SCALE = 0,
-    UNI_PIXBUF_DRAW_METHOD_CONTAINS = 1,
-    UNI_PIXBUF_DRAW_METHOD_SCROLL = 2
-} UniPixbufDrawMethod;
-
 /**
  * UniPixbufDrawOpts:
  *
@@ -53,20 +48,40 @@ struct _UniPixbufDrawOpts {
 
     GdkInterpType interp;
     GdkPixbuf *pixbuf;
+
+    /* Full resolution of @pixbuf, for images too large to decode
+     * whole. Used wherever @pixbuf would have to be magnified. */
+    UniTiledSource *source;
+
+    /* EXIF orientation @pixbuf is shown in. @zoom_rect is in the
+     * coordinates of the turned image. Tiled sources are always shown
+     * as stored. */
+    int orientation;
 };
 
 /**
  * UniPixbufDrawCache:
  *
- * Cache that ensures fast redraws by storing the last draw
- * operation. For example, when resizing a #UniImageView, the view
- * receives an expose event and must redraw the damaged region. Unless
- * fitting is %TRUE, most of the pixels it should draw are indentical
- * to the ones drawn the previous time. Redrawing them is wasteful
- * because scaling and especially bilinear scaling is very
- * slow. Therefore, PixbufDrawCache objectifies the drawing process
- * and adds a cache with the last draw from which pixels can be
- * fetched.
+ * Cache that ensures fast redraws by keeping the scaled image around.
+ * For example, when scrolling a #UniImageView, most of the pixels it
+ * should draw were drawn before, maybe just a moment ago on the way
+ * back. Scaling them again is wasteful because scaling and especially
+ * bilinear scaling is very slow.
+ *
+ * The scaled image is therefore cut into a grid of square tiles in
+ * zoom space, each scaled once and then kept in a #GdkPixmap on the X
+ * server. Drawing an area copies the tiles it touches, scaling only
+ * those not in the cache. Tiles are keyed by pixbuf, zoom, tiled
+ * source, interpolation and orientation, so changing any of those
+ * simply uses other tiles. The least recently used tiles are dropped
+ * once they take more than the budget.
+ *
+ * Tiles of transparent images are stored flattened over the
+ * checkerboard, which is anchored in zoom space, so redrawing them
+ * costs the same as redrawing opaque ones wherever the view scrolls.
+ *
+ * At 1:1 there is nothing to scale, so images shown as stored are
+ * drawn straight from the pixbuf and bypass the tiles.
  *
  * This object is present purely to ensure optimal speed. A
  * #GtkIImageTool that is asked to redraw a part of the image view
@@ -74,9 +89,19 @@ struct _UniPixbufDrawOpts {
  * gdk_draw_pixbuf().
  **/
 struct _UniPixbufDrawCache {
-    GdkPixbuf *last_pixbuf;
-    UniPixbufDrawOpts old;
-    int check_size;
+    /* UniDrawTile -> GList link in @lru, most recently used first */
+    GHashTable *tiles;
+    GQueue *lru;
+    gsize used;
+    gsize budget;
+
+    /* Tiles are sampled here before they are uploaded */
+    GdkPixbuf *scratch;
+
+    /* Made for drawables of @depth on @screen */
+    GdkGC *gc;
+    int depth;
+    GdkScreen *screen;
 };
 
 UniPixbufDrawCache* uni_pixbuf_draw_cache_new   (void);
@@ -86,8 +111,4 @@ void    uni_pixbuf_draw_cache_draw          (UniPixbufDrawCache * cache,
                                              UniPixbufDrawOpts * opts,
                                              GdkDrawable * drawable);
 
-UniPixbufDrawMethod uni_pixbuf_draw_cache_get_method (UniPixbufDrawOpts * old,
-                                                      UniPixbufDrawOpts *
-                                                      new_);
-
 #endif /* __UNI_CACHE_H__ */
@@ -27,6 +27,19 @@
 
 G_DEFINE_TYPE (UniDragger, uni_dragger, G_TYPE_OBJECT);
 
+/* Drag steps are applied at most this often, in ms, no matter how
+ * many motion events the mouse sends */
+#define UNI_DRAGGER_FRAME_TIME 16
+
+/* Share of its speed the view keeps per ms while gliding after a
+ * drag, and the speed in pixels per ms below which it stops */
+#define UNI_DRAGGER_FRICTION 0.996
+#define UNI_DRAGGER_MIN_VELOCITY 0.02
+
+/* A drag only glides on if the pointer still moved this shortly
+ * before the button was released, in ms */
+#define UNI_DRAGGER_FLING_DELAY 50
+
 
 /* Drag 'n Drop */
 static GtkTargetEntry target_table[] = {
@@ -53,6 +66,113 @@ uni_dragger_get_drag_delta (UniDragger * tool, int *x, int *y)
     *y = tool->drag_base_y - tool->drag_ofs_y;
 }
 
+/* Scrolls the view by how far the pointer moved since the last
+ * step. */
+static void
+uni_dragger_pan (UniDragger * tool)
+{
+    int dx, dy;
+    uni_dragger_get_drag_delta (tool, &dx, &dy);
+    if (dx == 0 && dy == 0)
+        return;
+
+    GdkRectangle viewport;
+    uni_image_view_get_viewport (UNI_IMAGE_VIEW (tool->view), &viewport);
+
+    int offset_x = viewport.x + dx;
+    int offset_y = viewport.y + dy;
+
+    uni_image_view_begin_preview (UNI_IMAGE_VIEW (tool->view));
+    uni_image_view_set_offset (UNI_IMAGE_VIEW (tool->view), offset_x,
+                               offset_y, FALSE);
+
+    tool->drag_base_x = tool->drag_ofs_x;
+    tool->drag_base_y = tool->drag_ofs_y;
+
+    /* Smoothed speed of the drag, for gliding on after it */
+    gint64 now = g_get_monotonic_time ();
+    gdouble dt = (now - tool->motion_time) / 1000.0;
+    if (tool->motion_time != 0 && dt > 0)
+    {
+        tool->velocity_x = 0.6 * dx / dt + 0.4 * tool->velocity_x;
+        tool->velocity_y = 0.6 * dy / dt + 0.4 * tool->velocity_y;
+    }
+    tool->motion_time = now;
+}
+
+static void
+uni_dragger_stop_kinetic (UniDragger * tool)
+{
+    if (!tool->kinetic_source)
+        return;
+    g_source_remove (tool->kinetic_source);
+    tool->kinetic_source = 0;
+}
+
+/* One frame of gliding on after a drag. The distance follows the time
+ * that actually passed, so slow frames don't slow the motion down, and
+ * the view drops to preview quality only if a frame goes over budget.
+ * Fractions of a pixel are carried over to the next frame. */
+static gboolean
+uni_dragger_kinetic_cb (UniDragger * tool)
+{
+    UniImageView *view = UNI_IMAGE_VIEW (tool->view);
+    gint64 now = g_get_monotonic_time ();
+    gdouble dt = (now - tool->kinetic_time) / 1000.0;
+    GdkRectangle before, after;
+    int dx, dy;
+
+    tool->kinetic_time = now;
+    tool->kinetic_x += tool->velocity_x * dt;
+    tool->kinetic_y += tool->velocity_y * dt;
+    dx = (int) tool->kinetic_x;
+    dy = (int) tool->kinetic_y;
+    tool->kinetic_x -= dx;
+    tool->kinetic_y -= dy;
+
+    tool->velocity_x *= pow (UNI_DRAGGER_FRICTION, dt);
+    tool->velocity_y *= pow (UNI_DRAGGER_FRICTION, dt);
+
+    if (dx || dy)
+    {
+        uni_image_view_get_viewport (view, &before);
+        uni_image_view_begin_frame (view);
+        uni_image_view_set_offset (view, before.x + dx, before.y + dy,
+                                   FALSE);
+        uni_image_view_get_viewport (view, &after);
+
+        /* Ran into the edges of the image */
+        if (before.x == after.x && before.y == after.y)
+            goto stop;
+    }
+
+    if (hypot (tool->velocity_x, tool->velocity_y) >= UNI_DRAGGER_MIN_VELOCITY)
+        return TRUE;
+
+stop:
+    tool->kinetic_source = 0;
+    return FALSE;
+}
+
+static gboolean
+uni_dragger_frame_cb (UniDragger * tool)
+{
+    int x, y;
+
+    tool->frame_source = 0;
+    if (!tool->pressed)
+        return FALSE;
+
+    /* Querying the pointer also asks X for the next motion hint, so
+       at most one motion event arrives between two frames. */
+    gdk_window_get_pointer (tool->view->window, &x, &y, NULL);
+    tool->drag_ofs_x = x;
+    tool->drag_ofs_y = y;
+
+    uni_dragger_pan (tool);
+    return FALSE;
+}
+
 /*************************************************************/
 /***** Actions ***********************************************/
 /*************************************************************/
@@ -60,12 +180,16 @@ uni_dragger_get_drag_delta (UniDragger * tool, int *x, int *y)
 gboolean
 uni_dragger_button_press (UniDragger * tool, GdkEventButton * ev)
 {
+    uni_dragger_stop_kinetic (tool);
     uni_dragger_grab_pointer (tool, ev->window, ev->time);
     tool->pressed = TRUE;
     tool->drag_base_x = ev->x;
     tool->drag_base_y = ev->y;
     tool->drag_ofs_x = ev->x;
     tool->drag_ofs_y = ev->y;
+    tool->velocity_x = 0.0;
+    tool->velocity_y = 0.0;
+    tool->motion_time = g_get_monotonic_time ();
 
     return TRUE;
 }
@@ -75,7 +199,28 @@ uni_dragger_button_release (UniDragger * tool, GdkEventButton * ev)
 {
     if (ev->button != 1)
         return FALSE;
+    if (tool->frame_source)
+    {
+        g_source_remove (tool->frame_source);
+        tool->frame_source = 0;
+        uni_dragger_pan (tool);
+    }
     gdk_pointer_ungrab (ev->time);
+
+    /* Flung, rather than dragged and held still */
+    if (tool->dragging && tool->motion_time != 0 &&
+        g_get_monotonic_time () - tool->motion_time
+        < UNI_DRAGGER_FLING_DELAY * 1000 &&
+        hypot (tool->velocity_x, tool->velocity_y) >= UNI_DRAGGER_MIN_VELOCITY)
+    {
+        tool->kinetic_time = g_get_monotonic_time ();
+        tool->kinetic_x = 0.0;
+        tool->kinetic_y = 0.0;
+        tool->kinetic_source =
+            g_timeout_add (UNI_DRAGGER_FRAME_TIME,
+                           (GSourceFunc) uni_dragger_kinetic_cb, tool);
+    }
+
     tool->pressed = FALSE;
     tool->dragging = FALSE;
     return TRUE;
@@ -110,18 +255,12 @@ uni_dragger_motion_notify (UniDragger * tool, GdkEventMotion * ev)
 		return TRUE;
     }
 
-    GdkRectangle viewport;
-    uni_image_view_get_viewport (UNI_IMAGE_VIEW (tool->view), &viewport);
-
-    int offset_x = viewport.x + dx;
-    int offset_y = viewport.y + dy;
-
-    uni_image_view_set_offset (UNI_IMAGE_VIEW (tool->view), offset_x,
-                               offset_y, FALSE);
-
-    tool->drag_base_x = tool->drag_ofs_x;
-    tool->drag_base_y = tool->drag_ofs_y;
-
+    /* The view scrolls once per frame, by however far the pointer
+       has moved by then. */
+    if (!tool->frame_source)
+        tool->frame_source = g_timeout_add (UNI_DRAGGER_FRAME_TIME,
+                                            (GSourceFunc) uni_dragger_frame_cb,
+                                            tool);
     return TRUE;
 }
 
@@ -129,6 +268,8 @@ void
 uni_dragger_pixbuf_changed (UniDragger * tool,
                             gboolean reset_fit, GdkRectangle * rect)
 {
+    if (reset_fit)
+        uni_dragger_stop_kinetic (tool);
     uni_pixbuf_draw_cache_invalidate (tool->cache);
 }
 
@@ -147,6 +288,9 @@ static void
 uni_dragger_finalize (GObject * object)
 {
     UniDragger *dragger = UNI_DRAGGER (object);
+    if (dragger->frame_source)
+        g_source_remove (dragger->frame_source);
+    uni_dragger_stop_kinetic (dragger);
     uni_pixbuf_draw_cache_free (dragger->cache);
 
     /* Chain up */
@@ -197,6 +341,11 @@ uni_dragger_init (UniDragger * tool)
     tool->drag_base_y = 0;
     tool->drag_ofs_x = 0;
     tool->drag_ofs_y = 0;
+    tool->frame_source = 0;
+    tool->velocity_x = 0.0;
+    tool->velocity_y = 0.0;
+    tool->motion_time = 0;
+    tool->kinetic_source = 0;
     tool->grab_cursor = gdk_cursor_new (GDK_FLEUR);
 }
 
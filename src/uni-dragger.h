@@ -52,6 +52,20 @@ struct _UniDragger {
     /* Current position of the mouse. */
     int drag_ofs_x;
     int drag_ofs_y;
+
+    /* Applies the movement so far at the next frame. */
+    guint frame_source;
+
+    /* Speed of the drag in pixels per ms, and when it last moved */
+    gdouble velocity_x;
+    gdouble velocity_y;
+    gint64 motion_time;
+
+    /* Glides on after a drag was let go */
+    guint kinetic_source;
+    gint64 kinetic_time;
+    gdouble kinetic_x;
+    gdouble kinetic_y;
     
     
     /* Cursor to use when grabbing. */
@@ -22,6 +22,7 @@
 
 #include <exiv2/exiv2.hpp>
 #include <iostream>
+#include <cstring>
 
 #include "uni-exiv2.hpp"
 
@@ -41,56 +42,75 @@ uni_exif_dictionary_map(void (*callback)(const char*, const char*, void*), void
     }
 }
 
-extern "C" 
-void 
-uni_read_exiv2_map(const char *uri, void (*callback)(const char*, const char*, void*), void *user_data)
+static void
+uni_read_exiv2_map_image(Exiv2::Image::AutoPtr image, void (*callback)(const char*, const char*, void*), void *user_data)
 {
-    Exiv2::LogMsg::setLevel(Exiv2::LogMsg::mute);
-    try {
-        Exiv2::Image::AutoPtr image = Exiv2::ImageFactory::open(uri);
-        if ( image.get() == 0 ) {
-            return;
-        }
+    if ( image.get() == 0 ) {
+        return;
+    }
 
-        image->readMetadata();
-        Exiv2::ExifData &exifData = image->exifData();
-        Exiv2::IptcData &iptcData = image->iptcData();
-
-        if ( !exifData.empty() ) {
-            Exiv2::ExifData::const_iterator pos;
-            uint i;
-            ExifDataDictionary dict;
-            for( i=0; i<sizeof(exifDataDictionary)/sizeof(exifDataDictionary[0]); i++ ) {
-                dict = exifDataDictionary[i];
-                
-                if ( dict.finder == NULL ) {
-                    Exiv2::ExifKey key(dict.key);
-                    pos = exifData.findKey(key);
-                } else {
-                    pos = dict.finder(exifData);
-                }
-
-                if ( pos != exifData.end() ) {
-                    callback(dict.label, pos->print(&exifData).c_str(), user_data);
-                }
+    image->readMetadata();
+    Exiv2::ExifData &exifData = image->exifData();
+    Exiv2::IptcData &iptcData = image->iptcData();
+
+    if ( !exifData.empty() ) {
+        Exiv2::ExifData::const_iterator pos;
+        uint i;
+        ExifDataDictionary dict;
+        for( i=0; i<sizeof(exifDataDictionary)/sizeof(exifDataDictionary[0]); i++ ) {
+            dict = exifDataDictionary[i];
+            
+            if ( dict.finder == NULL ) {
+                Exiv2::ExifKey key(dict.key);
+                pos = exifData.findKey(key);
+            } else {
+                pos = dict.finder(exifData);
+            }
+
+            if ( pos != exifData.end() ) {
+                callback(dict.label, pos->print(&exifData).c_str(), user_data);
             }
         }
+    }
 
-        if ( !iptcData.empty() ) {
-            Exiv2::IptcData::const_iterator pos;
-            uint i;
-            IptcDataDictionary dict;
-            for( i=0; i<sizeof(iptcDataDictionary)/sizeof(iptcDataDictionary[0]); i++ ) {
-                dict = iptcDataDictionary[i];
+    if ( !iptcData.empty() ) {
+        Exiv2::IptcData::const_iterator pos;
+        uint i;
+        IptcDataDictionary dict;
+        for( i=0; i<sizeof(iptcDataDictionary)/sizeof(iptcDataDictionary[0]); i++ ) {
+            dict = iptcDataDictionary[i];
 
-                Exiv2::IptcKey key(dict.key);
-                pos = iptcData.findKey(key);
+            Exiv2::IptcKey key(dict.key);
+            pos = iptcData.findKey(key);
 
-                if ( pos != iptcData.end() ) {
-                    callback(dict.label, pos->value().toString().c_str(), user_data);
-                }
+            if ( pos != iptcData.end() ) {
+                callback(dict.label, pos->value().toString().c_str(), user_data);
             }
         }
+    }
+}
+
+extern "C" 
+void 
+uni_read_exiv2_map(const char *uri, void (*callback)(const char*, const char*, void*), void *user_data)
+{
+    Exiv2::LogMsg::setLevel(Exiv2::LogMsg::mute);
+    try {
+        uni_read_exiv2_map_image(Exiv2::ImageFactory::open(uri), callback, user_data);
+    } catch (Exiv2::AnyError& e) {
+        std::cerr << "Exiv2: '" << e << "'\n";
+    }
+}
+
+/* Same as uni_read_exiv2_map(), for a file that has already been read
+ * into memory. Exiv2 parses the buffer through a MemIo. */
+extern "C" 
+void 
+uni_read_exiv2_map_from_buffer(const unsigned char *data, long size, void (*callback)(const char*, const char*, void*), void *user_data)
+{
+    Exiv2::LogMsg::setLevel(Exiv2::LogMsg::mute);
+    try {
+        uni_read_exiv2_map_image(Exiv2::ImageFactory::open(data, size), callback, user_data);
     } catch (Exiv2::AnyError& e) {
         std::cerr << "Exiv2: '" << e << "'\n";
     }
@@ -149,4 +169,64 @@ uni_write_exiv2_from_cache(const char *uri)
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+/* Exiv2 sets up the XMP toolkit on first use, which is not safe to do
+ * from several threads at once. Call this before any worker thread
+ * gets to read metadata. */
+extern "C"
+void
+uni_exiv2_initialize(void)
+{
+    Exiv2::XmpParser::initialize();
+}
+
+/* Extracts the largest preview embedded in an image that has been read
+ * into memory. Returns the encoded preview, to be freed with g_free(),
+ * or NULL if there is none. @orientation is set to the EXIF orientation
+ * of the image, @width and @height to its size as stored, or 0 if
+ * unknown. Safe to call from a worker thread. */
+extern "C"
+unsigned char *
+uni_read_exiv2_preview(const unsigned char *data, long size, long *preview_size,
+                       int *orientation, int *width, int *height)
+{
+    Exiv2::LogMsg::setLevel(Exiv2::LogMsg::mute);
+    try {
+        Exiv2::Image::AutoPtr image = Exiv2::ImageFactory::open(data, size);
+        if ( image.get() == 0 ) {
+            return NULL;
+        }
+
+        image->readMetadata();
+
+        Exiv2::PreviewManager manager(*image);
+        Exiv2::PreviewPropertiesList list = manager.getPreviewProperties();
+        if ( list.empty() ) {
+            return NULL;
+        }
+
+        /* The list is sorted by size, smallest first */
+        Exiv2::PreviewImage preview = manager.getPreviewImage(list.back());
+
+        *orientation = 1;
+        Exiv2::ExifData &exifData = image->exifData();
+        Exiv2::ExifData::const_iterator pos =
+            exifData.findKey(Exiv2::ExifKey("Exif.Image.Orientation"));
+        if ( pos != exifData.end() ) {
+            *orientation = pos->toLong();
+        }
+
+        *width = image->pixelWidth();
+        *height = image->pixelHeight();
+        *preview_size = preview.size();
+
+        unsigned char *copy = (unsigned char *) g_malloc(preview.size());
+        std::memcpy(copy, preview.pData(), preview.size());
+        return copy;
+    } catch (Exiv2::AnyError& e) {
+        std::cerr << "Exiv2: '" << e << "'\n";
+    }
+
+    return NULL;
+}
@@ -73,10 +73,22 @@ void    uni_exif_dictionary_map     (void (*callback)(const char*, const char*,
 void    uni_read_exiv2_map          (const char *uri, 
                                      void (*callback)(const char*, const char*, void*), 
                                      void *user_data);
+void    uni_read_exiv2_map_from_buffer  (const unsigned char *data,
+                                     long size,
+                                     void (*callback)(const char*, const char*, void*), 
+                                     void *user_data);
 
 int     uni_read_exiv2_to_cache     (const char *uri);
 int     uni_write_exiv2_from_cache  (const char *uri);
 
+void    uni_exiv2_initialize        (void);
+unsigned char *uni_read_exiv2_preview   (const unsigned char *data,
+                                     long size,
+                                     long *preview_size,
+                                     int *orientation,
+                                     int *width,
+                                     int *height);
+
 #ifdef __cplusplus
 
 } /* end extern "C" */
@@ -44,6 +44,19 @@
     g_signal_handlers_unblock_matched ((instance), G_SIGNAL_MATCH_DATA, \
                                        0, 0, NULL, NULL, (data))
 
+/* How long after the last step of a drag or wheel zoom the view is
+ * drawn again at full quality, in ms */
+#define UNI_IMAGE_VIEW_PREVIEW_TIMEOUT 200
+
+/* How long drawing one frame of an animation may take before the view
+ * falls back to preview quality, in ms */
+#define UNI_IMAGE_VIEW_FRAME_BUDGET 16
+
+/* How long a zoom step takes to play out, and how often the view is
+ * redrawn meanwhile, in ms */
+#define UNI_IMAGE_VIEW_ZOOM_TIME 150
+#define UNI_IMAGE_VIEW_ZOOM_FRAME_TIME 16
+
 /*************************************************************/
 /***** Private data ******************************************/
 /*************************************************************/
@@ -75,6 +88,8 @@ uni_image_view_get_pixbuf_size (UniImageView * view)
 
     s.width = gdk_pixbuf_get_width (view->pixbuf);
     s.height = gdk_pixbuf_get_height (view->pixbuf);
+    if (UNI_ORIENTATION_IS_TRANSPOSED (view->orientation))
+        s = (Size) {s.height, s.width};
     return s;
 }
 
@@ -230,6 +245,183 @@ uni_image_view_draw_background (UniImageView * view,
     }
 }
 
+static void
+uni_image_view_mipmap_ready (UniMipmap * mipmap, gpointer data)
+{
+    gtk_widget_queue_draw (GTK_WIDGET (data));
+}
+
+/* Redraws the pixels in @rect, or all of them if it is %NULL, without
+ * forgetting the mipmap. */
+static void
+uni_image_view_invalidate_pixels (UniImageView * view, GdkRectangle * rect)
+{
+    GtkWidget *widget = GTK_WIDGET (view);
+    GdkRectangle draw_rect;
+
+    uni_dragger_pixbuf_changed (UNI_DRAGGER (view->tool), FALSE, rect);
+
+    if (!gtk_widget_get_realized (widget)
+        || !uni_image_view_get_draw_rect (view, &draw_rect))
+        return;
+
+    if (rect)
+    {
+        /* Map to widget space, growing the area by a pixel on each
+           side to cover interpolation spreading into the neighbours. */
+        int x1 = floor ((rect->x - 1) * view->zoom - view->offset_x);
+        int y1 = floor ((rect->y - 1) * view->zoom - view->offset_y);
+        int x2 = ceil ((rect->x + rect->width + 1) * view->zoom
+                       - view->offset_x);
+        int y2 = ceil ((rect->y + rect->height + 1) * view->zoom
+                       - view->offset_y);
+        GdkRectangle damaged = {
+            draw_rect.x + x1, draw_rect.y + y1, x2 - x1, y2 - y1
+        };
+        if (!gdk_rectangle_intersect (&draw_rect, &damaged, &draw_rect))
+            return;
+    }
+
+    gdk_window_invalidate_rect (widget->window, &draw_rect, FALSE);
+}
+
+/* Redraws the part of the image that a tile loaded in the background
+ * covers. */
+static void
+uni_image_view_tile_loaded (UniTiledSource * source,
+                            GdkRectangle * area, gpointer data)
+{
+    UniImageView *view = data;
+    gdouble scale;
+    GdkRectangle rect;
+
+    if (view->pixbuf == NULL)
+        return;
+
+    /* The view works in the pixels of the rendition */
+    scale = (gdouble) gdk_pixbuf_get_width (view->pixbuf) / source->width;
+    rect.x = (int) floor (area->x * scale);
+    rect.y = (int) floor (area->y * scale);
+    rect.width = (int) ceil ((area->x + area->width) * scale) - rect.x;
+    rect.height = (int) ceil ((area->y + area->height) * scale) - rect.y;
+
+    uni_image_view_invalidate_pixels (view, &rect);
+}
+
+/* Forgets the tiled source, which stops loading tiles for the view. */
+static void
+uni_image_view_drop_tiled (UniImageView * view)
+{
+    if (view->tiled == NULL)
+        return;
+    uni_tiled_source_set_loaded_func (view->tiled, NULL, NULL);
+    uni_tiled_source_unref (view->tiled);
+    view->tiled = NULL;
+}
+
+/* Forgets the mipmap, whose levels no longer match the pixbuf. */
+static void
+uni_image_view_drop_mipmap (UniImageView * view)
+{
+    if (view->mipmap == NULL)
+        return;
+    uni_mipmap_free (view->mipmap);
+    view->mipmap = NULL;
+}
+
+static gboolean
+uni_image_view_preview_timeout_cb (UniImageView * view)
+{
+    view->preview_source = 0;
+    view->previewing = FALSE;
+
+    /* Exposes are double buffered, so the sharper image replaces the
+       preview in one go. */
+    gtk_widget_queue_draw (GTK_WIDGET (view));
+    return FALSE;
+}
+
+static void
+uni_image_view_stop_zoom (UniImageView * view)
+{
+    if (!view->zoom_source)
+        return;
+    g_source_remove (view->zoom_source);
+    view->zoom_source = 0;
+}
+
+/* The zoom the view is on its way to, which is where the next zoom
+   step should start from. */
+static gdouble
+uni_image_view_get_target_zoom (UniImageView * view)
+{
+    return view->zoom_source ? view->zoom_target : view->zoom;
+}
+
+/**
+ * uni_image_view_zoom_frame_cb:
+ *
+ * Draws one frame of an animated zoom. The zoom moves from
+ * zoom_start to zoom_target evenly in log space, easing out, and
+ * follows the time that actually passed so slow frames are skipped
+ * rather than drawn late. Frames in between drop to preview quality if
+ * drawing one goes over the frame budget; the last one ends any
+ * preview at once so the image is sharp as soon as it stops.
+ **/
+static gboolean
+uni_image_view_zoom_frame_cb (UniImageView * view)
+{
+    gdouble t = (g_get_monotonic_time () - view->zoom_time)
+        / (UNI_IMAGE_VIEW_ZOOM_TIME * 1000.0);
+    gdouble zoom = view->zoom_target;
+
+    if (t < 1.0)
+    {
+        gdouble eased = 1.0 - pow (1.0 - t, 3);
+        zoom = view->zoom_start
+            * pow (view->zoom_target / view->zoom_start, eased);
+        uni_image_view_begin_frame (view);
+    }
+    uni_image_view_set_zoom_with_center (view, zoom,
+                                         view->zoom_center_x,
+                                         view->zoom_center_y, FALSE);
+    if (t < 1.0)
+        return TRUE;
+
+    view->zoom_source = 0;
+    if (view->preview_source)
+    {
+        g_source_remove (view->preview_source);
+        uni_image_view_preview_timeout_cb (view);
+    }
+    return FALSE;
+}
+
+/**
+ * uni_image_view_animate_zoom:
+ *
+ * Zooms to @zoom over UNI_IMAGE_VIEW_ZOOM_TIME, keeping the point at
+ * @center_x, @center_y in widget coordinates in place. A zoom that is
+ * already playing continues from where it is towards the new target.
+ **/
+static void
+uni_image_view_animate_zoom (UniImageView * view,
+                             gdouble zoom, gdouble center_x, gdouble center_y)
+{
+    if (zoom == uni_image_view_get_target_zoom (view))
+        return;
+
+    view->zoom_start = view->zoom;
+    view->zoom_target = zoom;
+    view->zoom_center_x = center_x;
+    view->zoom_center_y = center_y;
+    view->zoom_time = g_get_monotonic_time ();
+    if (!view->zoom_source)
+        view->zoom_source =
+            g_timeout_add (UNI_IMAGE_VIEW_ZOOM_FRAME_TIME,
+                           (GSourceFunc) uni_image_view_zoom_frame_cb, view);
+}
+
 /**
  * uni_image_view_repaint_area:
  * @paint_rect: The rectangle on the widget that needs to be redrawn.
@@ -267,6 +459,21 @@ uni_image_view_repaint_area (UniImageView * view, GdkRectangle * paint_rect)
                                                    &paint_area);
     if (intersects && view->pixbuf)
     {
+        GdkPixbuf *pixbuf = view->pixbuf;
+        gdouble zoom = view->zoom;
+
+        /* Zoomed out, sample the mipmap level just above the zoom */
+        if (zoom <= 0.5)
+        {
+            if (view->mipmap == NULL)
+                view->mipmap = uni_mipmap_new (view->pixbuf,
+                                               uni_image_view_mipmap_ready,
+                                               view);
+            pixbuf = uni_mipmap_get_level (view->mipmap, zoom);
+            zoom *= (gdouble) gdk_pixbuf_get_width (view->pixbuf)
+                / gdk_pixbuf_get_width (pixbuf);
+        }
+
         int src_x =
             (int) ((view->offset_x + (gdouble) paint_area.x -
                     (gdouble) image_area.x) + 0.5);
@@ -275,12 +482,14 @@ uni_image_view_repaint_area (UniImageView * view, GdkRectangle * paint_rect)
                     (gdouble) image_area.y) + 0.5);
 
         UniPixbufDrawOpts opts = {
-            view->zoom,
+            zoom,
             (GdkRectangle) {src_x, src_y,
                             paint_area.width, paint_area.height},
             paint_area.x, paint_area.y,
-            view->interp,
-            view->pixbuf
+            view->previewing ? GDK_INTERP_NEAREST : view->interp,
+            pixbuf,
+            view->tiled,
+            view->orientation
         };
         uni_dragger_paint_image (UNI_DRAGGER(view->tool), &opts,
                                  widget->window);
@@ -350,14 +559,16 @@ uni_image_view_fast_scroll (UniImageView * view, int delta_x, int delta_y)
 
     /* If we moved in both the x and y directions, two "strips" of the
        image becomes visible. One horizontal strip and one vertical
-       strip. */
+       strip. They overlap in a corner, and so may the exposes below,
+       so everything is collected into a region that is painted once. */
+    GdkRegion *region = gdk_region_new ();
     GdkRectangle horiz_strip = {
         0,
         (delta_y < 0) ? 0 : alloc.height - abs (delta_y),
         alloc.width,
         abs (delta_y)
     };
-    uni_image_view_repaint_area (view, &horiz_strip);
+    gdk_region_union_with_rect (region, &horiz_strip);
 
     GdkRectangle vert_strip = {
         (delta_x < 0) ? 0 : alloc.width - abs (delta_x),
@@ -365,7 +576,7 @@ uni_image_view_fast_scroll (UniImageView * view, int delta_x, int delta_y)
         abs (delta_x),
         alloc.height
     };
-    uni_image_view_repaint_area (view, &vert_strip);
+    gdk_region_union_with_rect (region, &vert_strip);
 
     /* Here is where we fix the weirdness mentioned above. I do not
      * really know why it works, but it does! */
@@ -374,11 +585,17 @@ uni_image_view_fast_scroll (UniImageView * view, int delta_x, int delta_y)
     {
         GdkEventExpose *expose = (GdkEventExpose *) ev;
         int exp_count = expose->count;
-        uni_image_view_repaint_area (view, &expose->area);
+        gdk_region_union_with_rect (region, &expose->area);
         gdk_event_free (ev);
         if (exp_count == 0)
             break;
     }
+
+    /* Paint it right away, as one expose, so the strips never show
+       what was there before the copy. */
+    gdk_window_invalidate_region (drawable, region, FALSE);
+    gdk_region_destroy (region);
+    gdk_window_process_updates (drawable, FALSE);
 }
 
 /**
@@ -531,7 +748,22 @@ uni_image_view_size_allocate (GtkWidget * widget, GtkAllocation * alloc)
 static int
 uni_image_view_expose (GtkWidget * widget, GdkEventExpose * ev)
 {
-    return uni_image_view_repaint_area (UNI_IMAGE_VIEW (widget), &ev->area);
+    UniImageView *view = UNI_IMAGE_VIEW (widget);
+    gint64 start = g_get_monotonic_time ();
+    GdkRectangle *rects;
+    int n_rects, n;
+    int painted = FALSE;
+
+    /* The bounding box of a diagonal scroll or a partly covered window
+       is much larger than what needs painting. */
+    gdk_region_get_rectangles (ev->region, &rects, &n_rects);
+    for (n = 0; n < n_rects; n++)
+        painted |= uni_image_view_repaint_area (view, &rects[n]);
+    g_free (rects);
+
+    if (!view->previewing)
+        view->frame_cost = g_get_monotonic_time () - start;
+    return painted;
 }
 
 static int
@@ -653,16 +885,16 @@ uni_image_view_scroll_event (GtkWidget * widget, GdkEventScroll * ev)
                 if( ev->state & GDK_SHIFT_MASK ) {
                     vnr_window_prev(vnr_win);
                 } else {
-                    zoom = CLAMP (view->zoom * UNI_ZOOM_STEP, UNI_ZOOM_MIN, UNI_ZOOM_MAX);
-                    uni_image_view_set_zoom_with_center (view, zoom, ev->x, ev->y, FALSE);
+                    zoom = CLAMP (uni_image_view_get_target_zoom (view) * UNI_ZOOM_STEP, UNI_ZOOM_MIN, UNI_ZOOM_MAX);
+                    uni_image_view_animate_zoom (view, zoom, ev->x, ev->y);
                 }
                 break;
             default:
                 if( ev->state & GDK_SHIFT_MASK ) {
                     vnr_window_next(vnr_win, TRUE);
                 } else {
-                    zoom = CLAMP (view->zoom / UNI_ZOOM_STEP, UNI_ZOOM_MIN, UNI_ZOOM_MAX);
-                    uni_image_view_set_zoom_with_center (view, zoom, ev->x, ev->y, FALSE);
+                    zoom = CLAMP (uni_image_view_get_target_zoom (view) / UNI_ZOOM_STEP, UNI_ZOOM_MIN, UNI_ZOOM_MAX);
+                    uni_image_view_animate_zoom (view, zoom, ev->x, ev->y);
                 }
         }
 
@@ -672,20 +904,20 @@ uni_image_view_scroll_event (GtkWidget * widget, GdkEventScroll * ev)
         switch (ev->direction)
         {
             case GDK_SCROLL_LEFT:
-                zoom = CLAMP (view->zoom * UNI_ZOOM_STEP, UNI_ZOOM_MIN, UNI_ZOOM_MAX);
-                uni_image_view_set_zoom_with_center (view, zoom, ev->x, ev->y, FALSE);
+                zoom = CLAMP (uni_image_view_get_target_zoom (view) * UNI_ZOOM_STEP, UNI_ZOOM_MIN, UNI_ZOOM_MAX);
+                uni_image_view_animate_zoom (view, zoom, ev->x, ev->y);
                 break;
 
             case GDK_SCROLL_RIGHT:
-                zoom = CLAMP (view->zoom / UNI_ZOOM_STEP, UNI_ZOOM_MIN, UNI_ZOOM_MAX);
-                uni_image_view_set_zoom_with_center (view, zoom, ev->x, ev->y, FALSE);
+                zoom = CLAMP (uni_image_view_get_target_zoom (view) / UNI_ZOOM_STEP, UNI_ZOOM_MIN, UNI_ZOOM_MAX);
+                uni_image_view_animate_zoom (view, zoom, ev->x, ev->y);
                 break;
 
             case GDK_SCROLL_UP:
                 if( ev->state & GDK_SHIFT_MASK )
                 {
-                    zoom = CLAMP (view->zoom * UNI_ZOOM_STEP, UNI_ZOOM_MIN, UNI_ZOOM_MAX);
-                    uni_image_view_set_zoom_with_center (view, zoom, ev->x, ev->y, FALSE);
+                    zoom = CLAMP (uni_image_view_get_target_zoom (view) * UNI_ZOOM_STEP, UNI_ZOOM_MIN, UNI_ZOOM_MAX);
+                    uni_image_view_animate_zoom (view, zoom, ev->x, ev->y);
                 }
                 else
                     vnr_window_prev(vnr_win);
@@ -695,8 +927,8 @@ uni_image_view_scroll_event (GtkWidget * widget, GdkEventScroll * ev)
             default:
                 if( ev->state & GDK_SHIFT_MASK )
                 {
-                    zoom = CLAMP (view->zoom / UNI_ZOOM_STEP, UNI_ZOOM_MIN, UNI_ZOOM_MAX);
-                    uni_image_view_set_zoom_with_center (view, zoom, ev->x, ev->y, FALSE);
+                    zoom = CLAMP (uni_image_view_get_target_zoom (view) / UNI_ZOOM_STEP, UNI_ZOOM_MIN, UNI_ZOOM_MAX);
+                    uni_image_view_animate_zoom (view, zoom, ev->x, ev->y);
                 }
                 else
                     vnr_window_next(vnr_win, TRUE);
@@ -768,6 +1000,13 @@ uni_image_view_init (UniImageView * view)
     view->interp = GDK_INTERP_BILINEAR;
     view->fitting = UNI_FITTING_NORMAL;
     view->pixbuf = NULL;
+    view->tiled = NULL;
+    view->mipmap = NULL;
+    view->orientation = 1;
+    view->previewing = FALSE;
+    view->preview_source = 0;
+    view->frame_cost = 0;
+    view->zoom_source = 0;
     view->zoom = 1.0;
     view->offset_x = 0.0;
     view->offset_y = 0.0;
@@ -809,6 +1048,14 @@ uni_image_view_finalize (GObject * object)
         g_object_unref (view->pixbuf);
         view->pixbuf = NULL;
     }
+    uni_image_view_drop_tiled (view);
+    uni_image_view_drop_mipmap (view);
+    if (view->preview_source)
+    {
+        g_source_remove (view->preview_source);
+        view->preview_source = 0;
+    }
+    uni_image_view_stop_zoom (view);
     g_object_unref (view->tool);
     /* Chain up. */
     G_OBJECT_CLASS (uni_image_view_parent_class)->finalize (object);
@@ -1145,10 +1392,34 @@ void
 uni_image_view_set_fitting (UniImageView * view, UniFittingMode fitting)
 {
     g_return_if_fail (UNI_IS_IMAGE_VIEW (view));
+    uni_image_view_stop_zoom (view);
     view->fitting = fitting;
     gtk_widget_queue_resize (GTK_WIDGET (view));
 }
 
+/**
+ * uni_image_view_get_image_size:
+ * @view: A #UniImageView.
+ * @width: Return location for the width of the shown image.
+ * @height: Return location for the height of the shown image.
+ * @returns: %TRUE if the view shows a pixbuf, %FALSE otherwise.
+ *
+ * Gets the size of the pixbuf as shown, that is with width and height
+ * swapped if the orientation of the view turns it on its side.
+ **/
+gboolean
+uni_image_view_get_image_size (UniImageView * view, int *width, int *height)
+{
+    g_return_val_if_fail (UNI_IS_IMAGE_VIEW (view), FALSE);
+
+    Size size = uni_image_view_get_pixbuf_size (view);
+    if (width)
+        *width = size.width;
+    if (height)
+        *height = size.height;
+    return view->pixbuf != NULL;
+}
+
 /**
  * uni_image_view_get_pixbuf:
  * @view: A #UniImageView.
@@ -1197,10 +1468,16 @@ uni_image_view_set_pixbuf (UniImageView * view,
         view->pixbuf = pixbuf;
         if (view->pixbuf)
             g_object_ref (pixbuf);
+        uni_image_view_drop_tiled (view);
+        uni_image_view_drop_mipmap (view);
+        view->orientation = 1;
     }
 
     if (reset_fit)
+    {
+        uni_image_view_stop_zoom (view);
         uni_image_view_set_fitting (view, UNI_FITTING_NORMAL);
+    }
     else
     {
         /*
@@ -1220,6 +1497,137 @@ uni_image_view_set_pixbuf (UniImageView * view,
     uni_dragger_pixbuf_changed (UNI_DRAGGER(view->tool), reset_fit, NULL);
 }
 
+/**
+ * uni_image_view_replace_pixbuf:
+ * @view: A #UniImageView.
+ * @pixbuf: The pixbuf to display instead of the current one.
+ * @orientation: The EXIF orientation to show @pixbuf in.
+ *
+ * Replaces the current pixbuf with @pixbuf, which must show the same
+ * image at a different resolution, for example the full size decode
+ * of an image that was first loaded at a reduced size, or the same
+ * image with its orientation applied to the pixels.
+ *
+ * Unlike uni_image_view_set_pixbuf(), the zoom is adjusted so that the
+ * image keeps its size on screen, and the fit mode and the scroll
+ * position are left alone. Both the ::zoom-changed and the
+ * ::pixbuf-changed signals are emitted.
+ **/
+void
+uni_image_view_replace_pixbuf (UniImageView * view,
+                               GdkPixbuf * pixbuf, int orientation)
+{
+    g_return_if_fail (UNI_IS_IMAGE_VIEW (view));
+    g_return_if_fail (GDK_IS_PIXBUF (pixbuf));
+    g_return_if_fail (orientation >= 1 && orientation <= 8);
+
+    if (view->pixbuf == NULL)
+    {
+        uni_image_view_set_pixbuf (view, pixbuf, TRUE);
+        uni_image_view_set_orientation (view, orientation);
+        return;
+    }
+
+    /* The zoomed size stays the same, and so do the offsets, which
+       are in zoom space. */
+    Size old_size = uni_image_view_get_pixbuf_size (view);
+    int new_width = UNI_ORIENTATION_IS_TRANSPOSED (orientation)
+        ? gdk_pixbuf_get_height (pixbuf) : gdk_pixbuf_get_width (pixbuf);
+    gdouble ratio = (gdouble) old_size.width / new_width;
+    view->zoom *= ratio;
+    view->zoom_start *= ratio;
+    view->zoom_target *= ratio;
+
+    /* Absorb rounding errors, so that going to 1:1 stays exact. */
+    if (fabs (view->zoom - 1.0) < 1e-6)
+        view->zoom = 1.0;
+
+    g_object_ref (pixbuf);
+    g_object_unref (view->pixbuf);
+    view->pixbuf = pixbuf;
+    uni_image_view_drop_mipmap (view);
+    view->orientation = orientation;
+    uni_image_view_drop_tiled (view);
+
+    uni_image_view_update_adjustments (view);
+    gtk_widget_queue_draw (GTK_WIDGET (view));
+
+    g_signal_emit (G_OBJECT (view),
+                   uni_image_view_signals[ZOOM_CHANGED], 0);
+    g_signal_emit (G_OBJECT (view),
+                   uni_image_view_signals[PIXBUF_CHANGED], 0);
+    uni_dragger_pixbuf_changed (UNI_DRAGGER(view->tool), FALSE, NULL);
+}
+
+/**
+ * uni_image_view_set_orientation:
+ * @view: a #UniImageView
+ * @orientation: an EXIF orientation, from 1 to 8
+ *
+ * Shows the pixbuf turned or mirrored as described by @orientation,
+ * without touching its pixels. The turning happens while drawing, on
+ * the visible area only. Setting another pixbuf resets the
+ * orientation to 1, so this should be called after
+ * uni_image_view_set_pixbuf(). The ::pixbuf-changed signal is
+ * emitted.
+ **/
+void
+uni_image_view_set_orientation (UniImageView * view, int orientation)
+{
+    g_return_if_fail (UNI_IS_IMAGE_VIEW (view));
+    g_return_if_fail (orientation >= 1 && orientation <= 8);
+
+    if (view->orientation == orientation)
+        return;
+    view->orientation = orientation;
+
+    if (view->fitting != UNI_FITTING_NONE)
+        gtk_widget_queue_resize (GTK_WIDGET (view));
+    else
+    {
+        uni_image_view_scroll_to (view, view->offset_x, view->offset_y,
+                                  FALSE, FALSE);
+        uni_image_view_update_adjustments (view);
+        gtk_widget_queue_draw (GTK_WIDGET (view));
+    }
+
+    g_signal_emit (G_OBJECT (view),
+                   uni_image_view_signals[PIXBUF_CHANGED], 0);
+    uni_dragger_pixbuf_changed (UNI_DRAGGER (view->tool), FALSE, NULL);
+}
+
+/**
+ * uni_image_view_set_tiled_source:
+ * @view: a #UniImageView
+ * @source: the full resolution of the current pixbuf, or %NULL
+ *
+ * Tells the view that its pixbuf is a scaled down rendition of
+ * @source. When zoomed in beyond the resolution of the pixbuf, the
+ * view draws from the tiles of @source instead of magnifying the
+ * pixbuf, and redraws the parts whose tiles were still loading once
+ * they are in. Setting another pixbuf forgets @source again.
+ **/
+void
+uni_image_view_set_tiled_source (UniImageView * view,
+                                 UniTiledSource * source)
+{
+    g_return_if_fail (UNI_IS_IMAGE_VIEW (view));
+
+    if (view->tiled == source)
+        return;
+
+    if (source)
+        uni_tiled_source_ref (source);
+    uni_image_view_drop_tiled (view);
+    view->tiled = source;
+    if (source)
+        uni_tiled_source_set_loaded_func (source, uni_image_view_tile_loaded,
+                                          view);
+
+    uni_dragger_pixbuf_changed (UNI_DRAGGER (view->tool), FALSE, NULL);
+    gtk_widget_queue_draw (GTK_WIDGET (view));
+}
+
 /**
  * uni_image_view_set_zoom:
  * @view: a #UniImageView
@@ -1235,6 +1643,7 @@ uni_image_view_set_zoom (UniImageView * view, gdouble zoom)
 {
     g_return_if_fail (UNI_IS_IMAGE_VIEW (view));
     zoom = CLAMP (zoom, UNI_ZOOM_MIN, UNI_ZOOM_MAX);
+    uni_image_view_stop_zoom (view);
     uni_image_view_set_zoom_no_center (view, zoom, FALSE);
 }
 
@@ -1266,28 +1675,103 @@ uni_image_view_set_zoom_mode (UniImageView * view, VnrPrefsZoom mode)
  * uni_image_view_zoom_in:
  * @view: a #UniImageView
  *
- * Zoom in the view one step. Calling this method causes the widget to
- * immediately repaint itself.
+ * Zoom in the view one step around its center. The zoom plays out
+ * over a short animation; steps taken while it plays add up.
  **/
 void
 uni_image_view_zoom_in (UniImageView * view)
 {
     gdouble zoom;
-    zoom = CLAMP (view->zoom * UNI_ZOOM_STEP, UNI_ZOOM_MIN, UNI_ZOOM_MAX);
-    uni_image_view_set_zoom (view, zoom);
+    Size alloc = uni_image_view_get_allocated_size (view);
+    zoom = CLAMP (uni_image_view_get_target_zoom (view) * UNI_ZOOM_STEP,
+                  UNI_ZOOM_MIN, UNI_ZOOM_MAX);
+    uni_image_view_animate_zoom (view, zoom,
+                                 alloc.width / 2.0, alloc.height / 2.0);
 }
 
 /**
  * uni_image_view_zoom_out:
  * @view: a #UniImageView
  *
- * Zoom out the view one step. Calling this method causes the widget to
- * immediately repaint itself.
+ * Zoom out the view one step around its center. The zoom plays out
+ * over a short animation; steps taken while it plays add up.
  **/
 void
 uni_image_view_zoom_out (UniImageView * view)
 {
     gdouble zoom;
-    zoom = CLAMP (view->zoom / UNI_ZOOM_STEP, UNI_ZOOM_MIN, UNI_ZOOM_MAX);
-    uni_image_view_set_zoom (view, zoom);
+    Size alloc = uni_image_view_get_allocated_size (view);
+    zoom = CLAMP (uni_image_view_get_target_zoom (view) / UNI_ZOOM_STEP,
+                  UNI_ZOOM_MIN, UNI_ZOOM_MAX);
+    uni_image_view_animate_zoom (view, zoom,
+                                 alloc.width / 2.0, alloc.height / 2.0);
+}
+
+/**
+ * uni_image_view_begin_preview:
+ * @view: a #UniImageView
+ *
+ * Tells the view that it is being dragged or zoomed, and will be
+ * redrawn many times in a row. Until the gesture has been still for a
+ * moment, the view draws with %GDK_INTERP_NEAREST, and then redraws
+ * itself once at the interpolation it is set to. Call this on every
+ * step of the gesture.
+ **/
+void
+uni_image_view_begin_preview (UniImageView * view)
+{
+    g_return_if_fail (UNI_IS_IMAGE_VIEW (view));
+
+    if (view->interp == GDK_INTERP_NEAREST)
+        return;
+
+    view->previewing = TRUE;
+    if (view->preview_source)
+        g_source_remove (view->preview_source);
+    view->preview_source =
+        g_timeout_add (UNI_IMAGE_VIEW_PREVIEW_TIMEOUT,
+                       (GSourceFunc) uni_image_view_preview_timeout_cb, view);
+}
+
+/**
+ * uni_image_view_begin_frame:
+ * @view: a #UniImageView
+ *
+ * Tells the view that an animation is about to move it by one frame.
+ * The view keeps drawing at the interpolation it is set to, unless the
+ * last time it did so took longer than UNI_IMAGE_VIEW_FRAME_BUDGET.
+ * Then it switches to preview quality, as uni_image_view_begin_preview()
+ * does, for as long as the animation goes on.
+ **/
+void
+uni_image_view_begin_frame (UniImageView * view)
+{
+    g_return_if_fail (UNI_IS_IMAGE_VIEW (view));
+
+    if (view->frame_cost > UNI_IMAGE_VIEW_FRAME_BUDGET * 1000)
+        uni_image_view_begin_preview (view);
+}
+
+/**
+ * uni_image_view_damage_pixels:
+ * @view: a #UniImageView
+ * @rect: #GdkRectangle in image space coordinates to mark as damaged
+ *   or %NULL, to mark the whole pixbuf as damaged.
+ *
+ * Marks the pixels in @rect as damaged, meaning that the contents of
+ * the current pixbuf changed there and the view must redraw them. Use
+ * this instead of uni_image_view_set_pixbuf() when the pixbuf itself
+ * stays the same, for example while an image is still being decoded
+ * into it.
+ *
+ * Only the part of the widget showing @rect is invalidated, so the
+ * redraw scales no more of the image than what actually changed.
+ **/
+void
+uni_image_view_damage_pixels (UniImageView * view, GdkRectangle * rect)
+{
+    g_return_if_fail (UNI_IS_IMAGE_VIEW (view));
+
+    uni_image_view_drop_mipmap (view);
+    uni_image_view_invalidate_pixels (view, rect);
 }
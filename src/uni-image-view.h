@@ -27,6 +27,8 @@
 #include <gtk/gtk.h>
 
 #include "vnr-prefs.h"
+#include "uni-tiled-source.h"
+#include "uni-mipmap.h"
 
 G_BEGIN_DECLS
 #define UNI_TYPE_IMAGE_VIEW             (uni_image_view_get_type ())
@@ -51,6 +53,31 @@ struct _UniImageView {
     GdkInterpType interp;
     UniFittingMode fitting;
     GdkPixbuf *pixbuf;
+    /* Full resolution of @pixbuf, if it is a scaled down rendition of
+     * an image too large to decode whole. */
+    UniTiledSource *tiled;
+    /* Smaller copies of @pixbuf to draw from when zoomed out. Built
+     * the first time they are needed. */
+    UniMipmap *mipmap;
+    /* Drawn with GDK_INTERP_NEAREST during a drag or wheel zoom,
+     * until @preview_source fires. */
+    gboolean previewing;
+    guint preview_source;
+    /* How long the last expose took, in microseconds. Only exposes
+     * at full quality are timed. */
+    gint64 frame_cost;
+    /* Animated zoom from @zoom_start to @zoom_target around the
+     * widget point @zoom_center_x, @zoom_center_y, started at
+     * @zoom_time and stepped by @zoom_source. */
+    guint zoom_source;
+    gint64 zoom_time;
+    gdouble zoom_start;
+    gdouble zoom_target;
+    gdouble zoom_center_x;
+    gdouble zoom_center_y;
+    /* EXIF orientation to show @pixbuf in, 1 being as stored. Sizes
+     * and offsets are those of the turned image. */
+    int orientation;
     gdouble zoom;
     /* Offset in zoom space coordinates of the image area in the
      * widget. */
@@ -96,6 +123,9 @@ gboolean    uni_image_view_get_viewport     (UniImageView * view,
 gboolean    uni_image_view_get_draw_rect    (UniImageView * view,
                                              GdkRectangle * rect);
 
+gboolean    uni_image_view_get_image_size   (UniImageView * view,
+                                             int * width, int * height);
+
 /* Write-only properties */
 void        uni_image_view_set_offset       (UniImageView * view,
                                              gdouble x, gdouble y,
@@ -109,6 +139,13 @@ GdkPixbuf*  uni_image_view_get_pixbuf   (UniImageView * view);
 void        uni_image_view_set_pixbuf   (UniImageView * view,
                                          GdkPixbuf * pixbuf,
                                          gboolean reset_fit);
+void        uni_image_view_replace_pixbuf   (UniImageView * view,
+                                             GdkPixbuf * pixbuf,
+                                             int orientation);
+void        uni_image_view_set_orientation  (UniImageView * view,
+                                             int orientation);
+void        uni_image_view_set_tiled_source (UniImageView * view,
+                                             UniTiledSource * source);
 
 void        uni_image_view_set_zoom      (UniImageView * view, gdouble zoom);
 void        uni_image_view_set_zoom_mode (UniImageView * view, VnrPrefsZoom mode);
@@ -116,6 +153,8 @@ void        uni_image_view_set_zoom_mode (UniImageView * view, VnrPrefsZoom mode
 /* Actions */
 void        uni_image_view_zoom_in      (UniImageView * view);
 void        uni_image_view_zoom_out     (UniImageView * view);
+void        uni_image_view_begin_preview(UniImageView * view);
+void        uni_image_view_begin_frame  (UniImageView * view);
 void        uni_image_view_damage_pixels(UniImageView * view,
                                          GdkRectangle * rect);
 
@@ -0,0 +1,282 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <math.h>
+#include "uni-mipmap.h"
+
+/*************************************************************/
+/***** Static stuff ******************************************/
+/*************************************************************/
+
+typedef struct {
+    GdkPixbuf *from;
+    int count;
+    GPtrArray *built;
+} UniMipmapBuild;
+
+static void
+uni_mipmap_build_free (UniMipmapBuild * build)
+{
+    g_object_unref (build->from);
+    g_ptr_array_unref (build->built);
+    g_free (build);
+}
+
+static UniMipmap *
+uni_mipmap_ref (UniMipmap * mipmap)
+{
+    mipmap->ref_count++;
+    return mipmap;
+}
+
+static void
+uni_mipmap_unref (UniMipmap * mipmap)
+{
+    if (--mipmap->ref_count > 0)
+        return;
+
+    g_ptr_array_unref (mipmap->levels);
+    g_free (mipmap);
+}
+
+/**
+ * uni_mipmap_halve:
+ * @returns: a pixbuf half the size of @src, rounded up, every pixel of
+ *   which is the average of a 2x2 block of @src, or %NULL if @src is
+ *   a single pixel, memory ran out or @cancellable was cancelled.
+ *
+ * Colors are weighted by alpha, so that transparent pixels don't
+ * darken the edges of what they surround. At odd edges the last row
+ * or column is counted twice.
+ **/
+static GdkPixbuf *
+uni_mipmap_halve (GdkPixbuf * src, GCancellable * cancellable)
+{
+    int src_width = gdk_pixbuf_get_width (src);
+    int src_height = gdk_pixbuf_get_height (src);
+    int src_stride = gdk_pixbuf_get_rowstride (src);
+    int n_channels = gdk_pixbuf_get_n_channels (src);
+    gboolean alpha = gdk_pixbuf_get_has_alpha (src);
+    const guchar *src_pixels = gdk_pixbuf_get_pixels (src);
+    int width = (src_width + 1) / 2;
+    int height = (src_height + 1) / 2;
+    int dst_stride, x, y, c;
+    guchar *dst_pixels;
+    GdkPixbuf *dst;
+
+    if (src_width == 1 && src_height == 1)
+        return NULL;
+
+    dst = gdk_pixbuf_new (GDK_COLORSPACE_RGB, alpha, 8, width, height);
+    if (dst == NULL)
+        return NULL;
+    dst_stride = gdk_pixbuf_get_rowstride (dst);
+    dst_pixels = gdk_pixbuf_get_pixels (dst);
+
+    for (y = 0; y < height; y++)
+    {
+        const guchar *row0 = src_pixels + 2 * y * src_stride;
+        const guchar *row1 = src_pixels
+            + MIN (2 * y + 1, src_height - 1) * src_stride;
+        guchar *out = dst_pixels + y * dst_stride;
+
+        if (y % 64 == 0 && g_cancellable_is_cancelled (cancellable))
+        {
+            g_object_unref (dst);
+            return NULL;
+        }
+
+        for (x = 0; x < width; x++, out += n_channels)
+        {
+            int x0 = 2 * x * n_channels;
+            int x1 = MIN (2 * x + 1, src_width - 1) * n_channels;
+            int a00, a01, a10, a11, sum;
+
+            if (!alpha)
+            {
+                for (c = 0; c < n_channels; c++)
+                    out[c] = (row0[x0 + c] + row0[x1 + c]
+                              + row1[x0 + c] + row1[x1 + c] + 2) / 4;
+                continue;
+            }
+
+            a00 = row0[x0 + 3];
+            a01 = row0[x1 + 3];
+            a10 = row1[x0 + 3];
+            a11 = row1[x1 + 3];
+            sum = a00 + a01 + a10 + a11;
+
+            for (c = 0; c < 3; c++)
+                out[c] = sum == 0 ? 0
+                    : (row0[x0 + c] * a00 + row0[x1 + c] * a01
+                       + row1[x0 + c] * a10 + row1[x1 + c] * a11
+                       + sum / 2) / sum;
+            out[3] = (sum + 2) / 4;
+        }
+    }
+    return dst;
+}
+
+static void
+uni_mipmap_build_thread (GTask * task,
+                         gpointer source_object,
+                         gpointer task_data, GCancellable * cancellable)
+{
+    UniMipmapBuild *build = task_data;
+    GdkPixbuf *level = build->from;
+    int n;
+
+    for (n = 0; n < build->count; n++)
+    {
+        level = uni_mipmap_halve (level, cancellable);
+        if (level == NULL)
+            break;
+        g_ptr_array_add (build->built, level);
+    }
+    g_task_return_boolean (task, TRUE);
+}
+
+static void uni_mipmap_build (UniMipmap * mipmap);
+
+static void
+uni_mipmap_build_cb (GObject * source_object,
+                     GAsyncResult * result, gpointer user_data)
+{
+    UniMipmap *mipmap = user_data;
+    GTask *task = G_TASK (result);
+    UniMipmapBuild *build = g_task_get_task_data (task);
+    guint n;
+
+    /* Freed by its owner in the meantime */
+    if (g_cancellable_is_cancelled (g_task_get_cancellable (task)))
+    {
+        uni_mipmap_unref (mipmap);
+        return;
+    }
+
+    g_clear_object (&mipmap->cancellable);
+    for (n = 0; n < build->built->len; n++)
+        g_ptr_array_add (mipmap->levels,
+                         g_object_ref (g_ptr_array_index (build->built, n)));
+
+    /* Stopped early at a single pixel */
+    if (build->built->len < (guint) build->count)
+        mipmap->complete = TRUE;
+    /* Zoomed out further while this was running */
+    else if (mipmap->wanted >= (int) mipmap->levels->len)
+        uni_mipmap_build (mipmap);
+
+    if (build->built->len > 0 && mipmap->ready != NULL)
+        mipmap->ready (mipmap, mipmap->ready_data);
+    uni_mipmap_unref (mipmap);
+}
+
+/* Starts building the levels missing down to @mipmap->wanted. */
+static void
+uni_mipmap_build (UniMipmap * mipmap)
+{
+    UniMipmapBuild *build;
+    GTask *task;
+
+    build = g_new0 (UniMipmapBuild, 1);
+    build->from = g_object_ref (g_ptr_array_index (mipmap->levels,
+                                                   mipmap->levels->len - 1));
+    build->count = mipmap->wanted - mipmap->levels->len + 1;
+    build->built = g_ptr_array_new_with_free_func (g_object_unref);
+
+    mipmap->cancellable = g_cancellable_new ();
+    task = g_task_new (NULL, mipmap->cancellable,
+                       uni_mipmap_build_cb, uni_mipmap_ref (mipmap));
+    g_task_set_task_data (task, build, (GDestroyNotify) uni_mipmap_build_free);
+    g_task_run_in_thread (task, uni_mipmap_build_thread);
+    g_object_unref (task);
+}
+
+/*************************************************************/
+/***** Public API ********************************************/
+/*************************************************************/
+/**
+ * uni_mipmap_new:
+ * @pixbuf: the full size level, 8 bit RGB or RGBA
+ * @ready: called on the main thread whenever levels have been added
+ * @ready_data: data for @ready
+ * @returns: a new #UniMipmap holding @pixbuf only
+ *
+ * The pixels of @pixbuf must not change while the mipmap exists.
+ **/
+UniMipmap *
+uni_mipmap_new (GdkPixbuf * pixbuf, UniMipmapFunc ready, gpointer ready_data)
+{
+    UniMipmap *mipmap = g_new0 (UniMipmap, 1);
+
+    mipmap->ref_count = 1;
+    mipmap->levels = g_ptr_array_new_with_free_func (g_object_unref);
+    g_ptr_array_add (mipmap->levels, g_object_ref (pixbuf));
+    mipmap->ready = ready;
+    mipmap->ready_data = ready_data;
+    return mipmap;
+}
+
+/**
+ * uni_mipmap_free:
+ * @mipmap: a #UniMipmap
+ *
+ * Frees @mipmap. A build still running is cancelled, and its callback
+ * is not called anymore.
+ **/
+void
+uni_mipmap_free (UniMipmap * mipmap)
+{
+    mipmap->ready = NULL;
+    if (mipmap->cancellable != NULL)
+    {
+        g_cancellable_cancel (mipmap->cancellable);
+        g_clear_object (&mipmap->cancellable);
+    }
+    uni_mipmap_unref (mipmap);
+}
+
+/**
+ * uni_mipmap_get_level:
+ * @mipmap: a #UniMipmap
+ * @zoom: the zoom the full size level is to be drawn at
+ * @returns: the smallest level that is still at least as large as
+ *   @zoom asks for, or the smallest one built so far. The pixbuf is
+ *   owned by @mipmap.
+ *
+ * Starts building the level in the background if it isn't there yet.
+ **/
+GdkPixbuf *
+uni_mipmap_get_level (UniMipmap * mipmap, gdouble zoom)
+{
+    int level = 0;
+
+    if (zoom > 0.0 && zoom <= 0.5)
+        level = (int) floor (log2 (1.0 / zoom));
+
+    if (level >= (int) mipmap->levels->len)
+    {
+        mipmap->wanted = MAX (mipmap->wanted, level);
+        if (mipmap->cancellable == NULL && !mipmap->complete)
+            uni_mipmap_build (mipmap);
+        level = mipmap->levels->len - 1;
+    }
+    return g_ptr_array_index (mipmap->levels, level);
+}
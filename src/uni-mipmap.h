@@ -0,0 +1,75 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __UNI_MIPMAP_H__
+#define __UNI_MIPMAP_H__
+
+#include <gdk/gdk.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _UniMipmap UniMipmap;
+
+typedef void (*UniMipmapFunc) (UniMipmap * mipmap, gpointer data);
+
+/**
+ * UniMipmap:
+ *
+ * A pyramid of ever smaller copies of a pixbuf, each half the size of
+ * the one before and box filtered from it. Drawing a zoomed out view
+ * from the level just above the zoom samples far fewer pixels than
+ * drawing it from the full pixbuf, and aliases a lot less with
+ * %GDK_INTERP_NEAREST.
+ *
+ * Levels are built on a worker thread the first time they are asked
+ * for. Until then the closest level there is stands in, and the
+ * callback given to uni_mipmap_new() is run once more are ready.
+ *
+ * A mipmap must only be used from the main thread.
+ **/
+struct _UniMipmap {
+    int ref_count;
+
+    /* levels->pdata[0] is the pixbuf itself */
+    GPtrArray *levels;
+
+    /* Deepest level asked for so far */
+    int wanted;
+
+    /* The last level is a single pixel, or memory ran out */
+    gboolean complete;
+
+    /* Non-NULL while levels are being built */
+    GCancellable *cancellable;
+
+    UniMipmapFunc ready;
+    gpointer ready_data;
+};
+
+UniMipmap*  uni_mipmap_new          (GdkPixbuf * pixbuf,
+                                     UniMipmapFunc ready,
+                                     gpointer ready_data);
+void        uni_mipmap_free         (UniMipmap * mipmap);
+
+GdkPixbuf*  uni_mipmap_get_level    (UniMipmap * mipmap, gdouble zoom);
+
+G_END_DECLS
+#endif /* __UNI_MIPMAP_H__ */
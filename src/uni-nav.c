@@ -32,17 +32,14 @@ G_DEFINE_TYPE (UniNav, uni_nav, GTK_TYPE_WINDOW);
 static gdouble
 uni_nav_get_zoom (UniNav * nav)
 {
-    GdkPixbuf *pixbuf = uni_image_view_get_pixbuf (nav->view);
+    int img_width, img_height;
 
     /* If there is no image, we can't get it's width and height */
-    if (!pixbuf)
+    if (!uni_image_view_get_image_size (nav->view, &img_width, &img_height))
     {
         return 0.0;
     }
 
-    int img_width = gdk_pixbuf_get_width (pixbuf);
-    int img_height = gdk_pixbuf_get_height (pixbuf);
-
     gdouble width_zoom = (gdouble) UNI_NAV_MAX_WIDTH / (gdouble) img_width;
     gdouble height_zoom = (gdouble) UNI_NAV_MAX_HEIGHT / (gdouble) img_height;
     return MIN (width_zoom, height_zoom);
@@ -52,13 +49,11 @@ uni_nav_get_zoom (UniNav * nav)
 static Size
 uni_nav_get_preview_size (UniNav * nav)
 {
-    GdkPixbuf *pixbuf = uni_image_view_get_pixbuf (nav->view);
-    if (!pixbuf)
+    int img_width, img_height;
+    if (!uni_image_view_get_image_size (nav->view, &img_width, &img_height))
         return (Size)
     {
     UNI_NAV_MAX_WIDTH, UNI_NAV_MAX_HEIGHT};
-    int img_width = gdk_pixbuf_get_width (pixbuf);
-    int img_height = gdk_pixbuf_get_height (pixbuf);
 
     gdouble zoom = uni_nav_get_zoom (nav);
 
@@ -152,6 +147,12 @@ uni_nav_update_pixbuf (UniNav * nav)
         return;
 
     Size pw = uni_nav_get_preview_size (nav);
+    int orientation = nav->view->orientation;
+
+    /* The preview is scaled from the pixbuf as stored and turned
+       afterwards, which is cheap at this size. */
+    if (UNI_ORIENTATION_IS_TRANSPOSED (orientation))
+        pw = (Size) {pw.height, pw.width};
 
     nav->pixbuf = gdk_pixbuf_new (gdk_pixbuf_get_colorspace (pixbuf),
                                   gdk_pixbuf_get_has_alpha (pixbuf),
@@ -161,6 +162,14 @@ uni_nav_update_pixbuf (UniNav * nav)
                             0, 0,
                             uni_nav_get_zoom (nav),
                             GDK_INTERP_BILINEAR, 0, 0);
+
+    if (orientation != 1)
+    {
+        GdkPixbuf *turned = uni_pixbuf_apply_orientation (nav->pixbuf,
+                                                          orientation);
+        g_object_unref (nav->pixbuf);
+        nav->pixbuf = turned;
+    }
     // Lower the flag so the pixbuf isn't recreated more than
     // necessarily.
     nav->update_when_shown = FALSE;
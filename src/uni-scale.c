@@ -0,0 +1,571 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <math.h>
+#include <string.h>
+#include "uni-scale.h"
+#include "uni-utils.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UNI_SCALE_X86 1
+#include <immintrin.h>
+#endif
+
+/* Rounded division of a product of two bytes by 255 */
+#define UNI_DIV255(t) (((t) + 128 + (((t) + 128) >> 8)) >> 8)
+
+/**
+ * UniScaleKernels:
+ *
+ * The inner loops of uni_pixbuf_scale_fast(), one set per instruction
+ * set. The best set the processor supports is picked on first use.
+ *
+ * lerp_rows: blends @n bytes of two rows into 16 bit values,
+ *   row0 * (256 - weight) + row1 * weight, with @weight in 0..256.
+ * composite: puts @n premultiplied RGBA pixels over RGBA @checks,
+ *   writing opaque pixels to @out, which may be @src.
+ **/
+typedef struct {
+    void (*lerp_rows) (const guint8 * row0, const guint8 * row1,
+                       guint16 * out, int n, int weight);
+    void (*composite) (const guint8 * src, const guint8 * checks,
+                       guint8 * out, int n);
+} UniScaleKernels;
+
+/*************************************************************/
+/***** Portable kernels **************************************/
+/*************************************************************/
+static void
+lerp_rows_c (const guint8 * row0, const guint8 * row1,
+             guint16 * out, int n, int weight)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        out[i] = row0[i] * (256 - weight) + row1[i] * weight;
+}
+
+static void
+composite_c (const guint8 * src, const guint8 * checks, guint8 * out, int n)
+{
+    int i, c;
+
+    for (i = 0; i < n; i++, src += 4, checks += 4, out += 4)
+    {
+        int inv = 255 - src[3];
+
+        for (c = 0; c < 3; c++)
+            out[c] = MIN (src[c] + UNI_DIV255 (checks[c] * inv), 255);
+        out[3] = 255;
+    }
+}
+
+static const UniScaleKernels uni_scale_kernels_c = {
+    lerp_rows_c,
+    composite_c
+};
+
+#ifdef UNI_SCALE_X86
+/*************************************************************/
+/***** SSE2 kernels ******************************************/
+/*************************************************************/
+__attribute__ ((target ("sse2"))) static void
+lerp_rows_sse2 (const guint8 * row0, const guint8 * row1,
+                guint16 * out, int n, int weight)
+{
+    __m128i zero = _mm_setzero_si128 ();
+    __m128i w0 = _mm_set1_epi16 (256 - weight);
+    __m128i w1 = _mm_set1_epi16 (weight);
+    int i;
+
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        __m128i a = _mm_loadu_si128 ((const __m128i *) (row0 + i));
+        __m128i b = _mm_loadu_si128 ((const __m128i *) (row1 + i));
+        __m128i lo, hi;
+
+        lo = _mm_add_epi16 (_mm_mullo_epi16 (_mm_unpacklo_epi8 (a, zero), w0),
+                            _mm_mullo_epi16 (_mm_unpacklo_epi8 (b, zero), w1));
+        hi = _mm_add_epi16 (_mm_mullo_epi16 (_mm_unpackhi_epi8 (a, zero), w0),
+                            _mm_mullo_epi16 (_mm_unpackhi_epi8 (b, zero), w1));
+        _mm_storeu_si128 ((__m128i *) (out + i), lo);
+        _mm_storeu_si128 ((__m128i *) (out + i + 8), hi);
+    }
+    lerp_rows_c (row0 + i, row1 + i, out + i, n - i, weight);
+}
+
+__attribute__ ((target ("sse2"))) static void
+composite_sse2 (const guint8 * src, const guint8 * checks, guint8 * out, int n)
+{
+    __m128i zero = _mm_setzero_si128 ();
+    __m128i round = _mm_set1_epi16 (128);
+    __m128i opaque = _mm_set1_epi32 ((int) 0xff000000);
+    __m128i full = _mm_set1_epi32 (255);
+    int i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        __m128i s = _mm_loadu_si128 ((const __m128i *) (src + i * 4));
+        __m128i k = _mm_loadu_si128 ((const __m128i *) (checks + i * 4));
+        __m128i inv, lo, hi;
+
+        /* 255 - alpha, spread over the four channels of each pixel */
+        inv = _mm_sub_epi32 (full, _mm_srli_epi32 (s, 24));
+        inv = _mm_or_si128 (inv, _mm_slli_epi32 (inv, 16));
+
+        lo = _mm_mullo_epi16 (_mm_unpacklo_epi8 (k, zero),
+                              _mm_unpacklo_epi32 (inv, inv));
+        hi = _mm_mullo_epi16 (_mm_unpackhi_epi8 (k, zero),
+                              _mm_unpackhi_epi32 (inv, inv));
+        lo = _mm_add_epi16 (lo, round);
+        hi = _mm_add_epi16 (hi, round);
+        lo = _mm_srli_epi16 (_mm_add_epi16 (lo, _mm_srli_epi16 (lo, 8)), 8);
+        hi = _mm_srli_epi16 (_mm_add_epi16 (hi, _mm_srli_epi16 (hi, 8)), 8);
+
+        s = _mm_adds_epu8 (s, _mm_packus_epi16 (lo, hi));
+        _mm_storeu_si128 ((__m128i *) (out + i * 4), _mm_or_si128 (s, opaque));
+    }
+    composite_c (src + i * 4, checks + i * 4, out + i * 4, n - i);
+}
+
+static const UniScaleKernels uni_scale_kernels_sse2 = {
+    lerp_rows_sse2,
+    composite_sse2
+};
+
+/*************************************************************/
+/***** AVX2 kernels ******************************************/
+/*************************************************************/
+__attribute__ ((target ("avx2"))) static void
+lerp_rows_avx2 (const guint8 * row0, const guint8 * row1,
+                guint16 * out, int n, int weight)
+{
+    __m256i w0 = _mm256_set1_epi16 (256 - weight);
+    __m256i w1 = _mm256_set1_epi16 (weight);
+    int i;
+
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        __m256i a = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *) (row0 + i)));
+        __m256i b = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *) (row1 + i)));
+
+        _mm256_storeu_si256 ((__m256i *) (out + i),
+                             _mm256_add_epi16 (_mm256_mullo_epi16 (a, w0),
+                                               _mm256_mullo_epi16 (b, w1)));
+    }
+    lerp_rows_c (row0 + i, row1 + i, out + i, n - i, weight);
+}
+
+__attribute__ ((target ("avx2"))) static void
+composite_avx2 (const guint8 * src, const guint8 * checks, guint8 * out, int n)
+{
+    __m256i zero = _mm256_setzero_si256 ();
+    __m256i round = _mm256_set1_epi16 (128);
+    __m256i opaque = _mm256_set1_epi32 ((int) 0xff000000);
+    __m256i full = _mm256_set1_epi32 (255);
+    int i;
+
+    /* Same as composite_sse2(); the unpacks work within each 128 bit
+     * lane, and the pack puts the pixels back in order. */
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        __m256i s = _mm256_loadu_si256 ((const __m256i *) (src + i * 4));
+        __m256i k = _mm256_loadu_si256 ((const __m256i *) (checks + i * 4));
+        __m256i inv, lo, hi;
+
+        inv = _mm256_sub_epi32 (full, _mm256_srli_epi32 (s, 24));
+        inv = _mm256_or_si256 (inv, _mm256_slli_epi32 (inv, 16));
+
+        lo = _mm256_mullo_epi16 (_mm256_unpacklo_epi8 (k, zero),
+                                 _mm256_unpacklo_epi32 (inv, inv));
+        hi = _mm256_mullo_epi16 (_mm256_unpackhi_epi8 (k, zero),
+                                 _mm256_unpackhi_epi32 (inv, inv));
+        lo = _mm256_add_epi16 (lo, round);
+        hi = _mm256_add_epi16 (hi, round);
+        lo = _mm256_srli_epi16 (_mm256_add_epi16 (lo, _mm256_srli_epi16 (lo, 8)), 8);
+        hi = _mm256_srli_epi16 (_mm256_add_epi16 (hi, _mm256_srli_epi16 (hi, 8)), 8);
+
+        s = _mm256_adds_epu8 (s, _mm256_packus_epi16 (lo, hi));
+        _mm256_storeu_si256 ((__m256i *) (out + i * 4),
+                             _mm256_or_si256 (s, opaque));
+    }
+    composite_sse2 (src + i * 4, checks + i * 4, out + i * 4, n - i);
+}
+
+static const UniScaleKernels uni_scale_kernels_avx2 = {
+    lerp_rows_avx2,
+    composite_avx2
+};
+#endif /* UNI_SCALE_X86 */
+
+static const UniScaleKernels *
+uni_scale_get_kernels (void)
+{
+    static gsize kernels = 0;
+
+    if (g_once_init_enter (&kernels))
+    {
+        const UniScaleKernels *best = &uni_scale_kernels_c;
+
+#ifdef UNI_SCALE_X86
+        __builtin_cpu_init ();
+        if (__builtin_cpu_supports ("avx2"))
+            best = &uni_scale_kernels_avx2;
+        else if (__builtin_cpu_supports ("sse2"))
+            best = &uni_scale_kernels_sse2;
+#endif
+        g_once_init_leave (&kernels, (gsize) best);
+    }
+    return (const UniScaleKernels *) kernels;
+}
+
+/*************************************************************/
+/***** Private helpers ***************************************/
+/*************************************************************/
+static gboolean
+uni_scale_is_supported (GdkPixbuf * pixbuf)
+{
+    return gdk_pixbuf_get_colorspace (pixbuf) == GDK_COLORSPACE_RGB
+        && gdk_pixbuf_get_bits_per_sample (pixbuf) == 8
+        && gdk_pixbuf_get_n_channels (pixbuf)
+        == (gdk_pixbuf_get_has_alpha (pixbuf) ? 4 : 3);
+}
+
+static void
+uni_scale_premultiply (const guint8 * src, guint8 * out, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++, src += 4, out += 4)
+    {
+        out[0] = UNI_DIV255 (src[0] * src[3]);
+        out[1] = UNI_DIV255 (src[1] * src[3]);
+        out[2] = UNI_DIV255 (src[2] * src[3]);
+        out[3] = src[3];
+    }
+}
+
+/* The checkerboard row for rows where the first square is light (0)
+ * or dark (1). Squares are counted from -check_x, as gdk-pixbuf does. */
+static void
+uni_scale_fill_checks (guint8 * checks, int width, int check_x, int parity)
+{
+    int j;
+
+    for (j = 0; j < width; j++, checks += 4)
+    {
+        guint32 color = (((j + check_x) / CHECK_SIZE + parity) & 1)
+            ? CHECK_DARK : CHECK_LIGHT;
+
+        checks[0] = (color >> 16) & 0xff;
+        checks[1] = (color >> 8) & 0xff;
+        checks[2] = color & 0xff;
+        checks[3] = 0xff;
+    }
+}
+
+/* Source position and 8 bit fraction of a destination pixel for
+ * bilinear magnification, pixel centers mapped onto pixel centers. */
+static void
+uni_scale_bilinear_position (int pos, gdouble zoom, int size,
+                             int *index, int *weight)
+{
+    gdouble x = (pos + 0.5) / zoom - 0.5;
+    int i = (int) floor (x);
+    int w = (int) ((x - i) * 256 + 0.5);
+
+    if (w == 256)
+    {
+        i++;
+        w = 0;
+    }
+    if (i < 0)
+    {
+        i = 0;
+        w = 0;
+    }
+    else if (i >= size - 1)
+    {
+        i = size - 1;
+        w = 0;
+    }
+    *index = i;
+    *weight = w;
+}
+
+/* Writes a row of @n pixels with @n_src channels to @dst, which has
+ * @n_dst. An alpha channel in @dst is made opaque. */
+static void
+uni_scale_store_row (const guint8 * row, int n_src,
+                     guint8 * dst, int n_dst, int n)
+{
+    int j;
+
+    if (n_src == n_dst)
+    {
+        memcpy (dst, row, n * n_dst);
+        return;
+    }
+    for (j = 0; j < n; j++, row += n_src, dst += n_dst)
+    {
+        dst[0] = row[0];
+        dst[1] = row[1];
+        dst[2] = row[2];
+        if (n_dst == 4)
+            dst[3] = 0xff;
+    }
+}
+
+/*************************************************************/
+/***** Public API ********************************************/
+/*************************************************************/
+/**
+ * uni_pixbuf_scale_fast:
+ * @returns: %TRUE if the area was drawn, %FALSE if the combination
+ *   of pixbufs, interpolation and zoom has no fast path and the
+ *   caller has to use gdk-pixbuf.
+ *
+ * A faster version of uni_pixbuf_scale_blend() for what the image
+ * view draws most: 8 bit RGB and RGBA pixbufs with
+ * %GDK_INTERP_NEAREST at any zoom and %GDK_INTERP_BILINEAR when
+ * magnifying. Shrinking with %GDK_INTERP_BILINEAR averages over whole
+ * areas in gdk-pixbuf, and is left to it.
+ *
+ * The result may differ from gdk-pixbuf's by a level of rounding,
+ * but like it, depends only on the absolute position of each pixel.
+ **/
+gboolean
+uni_pixbuf_scale_fast (GdkPixbuf * src,
+                       GdkPixbuf * dst,
+                       int dst_x,
+                       int dst_y,
+                       int dst_width,
+                       int dst_height,
+                       gdouble offset_x,
+                       gdouble offset_y,
+                       gdouble zoom,
+                       GdkInterpType interp, int check_x, int check_y)
+{
+    const UniScaleKernels *kernels;
+    gboolean bilinear, alpha;
+    int src_width, src_height, src_stride, n_src;
+    int dst_stride, n_dst;
+    int ox, oy, span_x, span, i, j, c;
+    const guint8 *src_pixels;
+    guint8 *dst_pixels;
+    int *cols, *weights;
+    guint8 *row, *checks, *pm0, *pm1;
+    guint16 *vert;
+
+    if (interp == GDK_INTERP_NEAREST)
+        bilinear = FALSE;
+    else if (interp == GDK_INTERP_BILINEAR && zoom >= 1.0)
+        bilinear = TRUE;
+    else
+        return FALSE;
+
+    if (!uni_scale_is_supported (src) || !uni_scale_is_supported (dst))
+        return FALSE;
+    if (dst_width <= 0 || dst_height <= 0)
+        return TRUE;
+
+    kernels = uni_scale_get_kernels ();
+
+    alpha = gdk_pixbuf_get_has_alpha (src);
+    src_width = gdk_pixbuf_get_width (src);
+    src_height = gdk_pixbuf_get_height (src);
+    src_stride = gdk_pixbuf_get_rowstride (src);
+    src_pixels = gdk_pixbuf_get_pixels (src);
+    n_src = gdk_pixbuf_get_n_channels (src);
+    dst_stride = gdk_pixbuf_get_rowstride (dst);
+    dst_pixels = gdk_pixbuf_get_pixels (dst);
+    n_dst = gdk_pixbuf_get_n_channels (dst);
+
+    /* gdk-pixbuf rounds the offsets the same way */
+    ox = (int) floor (offset_x + 0.5);
+    oy = (int) floor (offset_y + 0.5);
+
+    cols = g_new (int, dst_width);
+    weights = g_new0 (int, dst_width);
+    for (j = 0; j < dst_width; j++)
+    {
+        int pos = dst_x + j - ox;
+
+        if (bilinear)
+            uni_scale_bilinear_position (pos, zoom, src_width,
+                                         &cols[j], &weights[j]);
+        else
+            cols[j] = CLAMP ((int) floor ((pos + 0.5) / zoom),
+                             0, src_width - 1);
+    }
+
+    /* The source columns the destination row is made from */
+    span_x = cols[0];
+    span = MIN (cols[dst_width - 1] + 2, src_width) - span_x;
+
+    row = g_new (guint8, dst_width * 4);
+    checks = NULL;
+    if (alpha)
+    {
+        checks = g_new (guint8, dst_width * 4 * 2);
+        uni_scale_fill_checks (checks, dst_width, check_x, 0);
+        uni_scale_fill_checks (checks + dst_width * 4, dst_width, check_x, 1);
+    }
+    pm0 = pm1 = NULL;
+    vert = NULL;
+    if (bilinear)
+    {
+        /* One spare pixel for the last column, whose weight is 0 */
+        vert = g_new0 (guint16, (span + 1) * n_src);
+        if (alpha)
+        {
+            pm0 = g_new (guint8, span * 4);
+            pm1 = g_new (guint8, span * 4);
+        }
+    }
+
+    for (i = 0; i < dst_height; i++)
+    {
+        int pos = dst_y + i - oy;
+        guint8 *out = row;
+
+        if (bilinear)
+        {
+            const guint8 *row0, *row1;
+            int y, weight;
+
+            uni_scale_bilinear_position (pos, zoom, src_height, &y, &weight);
+            row0 = src_pixels + y * src_stride + span_x * n_src;
+            row1 = src_pixels + MIN (y + 1, src_height - 1) * src_stride
+                + span_x * n_src;
+
+            /* Interpolating premultiplied pixels keeps the color of
+             * transparent ones from bleeding into their neighbours */
+            if (alpha)
+            {
+                uni_scale_premultiply (row0, pm0, span);
+                uni_scale_premultiply (row1, pm1, span);
+                row0 = pm0;
+                row1 = pm1;
+            }
+            kernels->lerp_rows (row0, row1, vert, span * n_src, weight);
+
+            for (j = 0; j < dst_width; j++, out += n_src)
+            {
+                const guint16 *p = vert + (cols[j] - span_x) * n_src;
+                int w = weights[j];
+
+                for (c = 0; c < n_src; c++)
+                    out[c] = (p[c] * (256 - w) + p[c + n_src] * w + 32768) >> 16;
+            }
+        }
+        else
+        {
+            const guint8 *line;
+
+            line = src_pixels
+                + CLAMP ((int) floor ((pos + 0.5) / zoom), 0, src_height - 1)
+                * src_stride;
+
+            for (j = 0; j < dst_width; j++, out += n_src)
+                memcpy (out, line + cols[j] * n_src, n_src);
+            if (alpha)
+                uni_scale_premultiply (row, row, dst_width);
+        }
+
+        if (alpha)
+            kernels->composite (row,
+                                checks + ((((i + check_y) / CHECK_SIZE) & 1)
+                                          ? dst_width * 4 : 0),
+                                row, dst_width);
+
+        uni_scale_store_row (row, n_src,
+                             dst_pixels + (dst_y + i) * dst_stride
+                             + dst_x * n_dst, n_dst, dst_width);
+    }
+
+    g_free (cols);
+    g_free (weights);
+    g_free (row);
+    g_free (checks);
+    g_free (vert);
+    g_free (pm0);
+    g_free (pm1);
+    return TRUE;
+}
+
+/**
+ * uni_pixbuf_blend_checks:
+ * @src: an 8 bit RGBA pixbuf, already scaled
+ * @dst: an 8 bit RGB or RGBA pixbuf
+ * @dst_x: where to put @src in @dst
+ * @dst_y: where to put @src in @dst
+ * @check_x: the checkerboard origin, relative to @dst_x
+ * @check_y: the checkerboard origin, relative to @dst_y
+ * @returns: %FALSE if the pixbufs are in a format this can't handle.
+ *
+ * Puts all of @src over the checkerboard into @dst, the same way
+ * uni_pixbuf_scale_fast() flattens transparent images.
+ **/
+gboolean
+uni_pixbuf_blend_checks (GdkPixbuf * src,
+                         GdkPixbuf * dst,
+                         int dst_x, int dst_y, int check_x, int check_y)
+{
+    const UniScaleKernels *kernels;
+    int width, height, src_stride, dst_stride, n_dst, i;
+    const guint8 *src_pixels;
+    guint8 *dst_pixels, *row, *checks;
+
+    if (!gdk_pixbuf_get_has_alpha (src)
+        || !uni_scale_is_supported (src) || !uni_scale_is_supported (dst))
+        return FALSE;
+
+    kernels = uni_scale_get_kernels ();
+
+    width = gdk_pixbuf_get_width (src);
+    height = gdk_pixbuf_get_height (src);
+    src_stride = gdk_pixbuf_get_rowstride (src);
+    src_pixels = gdk_pixbuf_get_pixels (src);
+    dst_stride = gdk_pixbuf_get_rowstride (dst);
+    dst_pixels = gdk_pixbuf_get_pixels (dst);
+    n_dst = gdk_pixbuf_get_n_channels (dst);
+
+    row = g_new (guint8, width * 4);
+    checks = g_new (guint8, width * 4 * 2);
+    uni_scale_fill_checks (checks, width, check_x, 0);
+    uni_scale_fill_checks (checks + width * 4, width, check_x, 1);
+
+    for (i = 0; i < height; i++)
+    {
+        uni_scale_premultiply (src_pixels + i * src_stride, row, width);
+        kernels->composite (row,
+                            checks + ((((i + check_y) / CHECK_SIZE) & 1)
+                                      ? width * 4 : 0),
+                            row, width);
+        uni_scale_store_row (row, 4,
+                             dst_pixels + (dst_y + i) * dst_stride
+                             + dst_x * n_dst, n_dst, width);
+    }
+
+    g_free (row);
+    g_free (checks);
+    return TRUE;
+}
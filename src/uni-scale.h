@@ -0,0 +1,48 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __UNI_SCALE_H__
+#define __UNI_SCALE_H__
+
+#include <gdk/gdk.h>
+
+G_BEGIN_DECLS
+
+gboolean    uni_pixbuf_scale_fast       (GdkPixbuf * src,
+                                         GdkPixbuf * dst,
+                                         int dst_x,
+                                         int dst_y,
+                                         int dst_width,
+                                         int dst_height,
+                                         gdouble offset_x,
+                                         gdouble offset_y,
+                                         gdouble zoom,
+                                         GdkInterpType interp,
+                                         int check_x, int check_y);
+
+gboolean    uni_pixbuf_blend_checks     (GdkPixbuf * src,
+                                         GdkPixbuf * dst,
+                                         int dst_x,
+                                         int dst_y,
+                                         int check_x, int check_y);
+
+G_END_DECLS
+
+#endif /* __UNI_SCALE_H__ */
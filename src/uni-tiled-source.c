@@ -0,0 +1,800 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include "uni-tiled-source.h"
+#include "uni-utils.h"
+
+/* Tiles kept per source, which bounds the memory a source takes
+ * regardless of the size of the image. */
+#define UNI_TILED_SOURCE_BUDGET (96 * 1024 * 1024)
+
+/* Pixels taken from the neighbours of a tile when it is scaled, enough
+ * for the filter to reach across the edge at any zoom a level is drawn
+ * at. Without them every tile edge shows as a seam. */
+#define UNI_TILED_SOURCE_BORDER 2
+
+/* Tiles waiting to be loaded. Older requests are for areas long
+ * scrolled away from and are asked for again if drawn once more. */
+#define UNI_TILED_SOURCE_MAX_WANTED 128
+
+typedef struct {
+    gint64 key;
+    GdkPixbuf *pixbuf;
+} UniTile;
+
+typedef struct {
+    int level;
+    int col;
+    int row;
+} UniTileRequest;
+
+typedef struct {
+    UniTiledSource *source;
+    GdkRectangle area;
+} UniTileLoaded;
+
+/*************************************************************/
+/***** Static stuff ******************************************/
+/*************************************************************/
+
+static gint64
+uni_tiled_source_key (int level, int col, int row)
+{
+    return ((gint64) level << 48) | ((gint64) row << 24) | (gint64) col;
+}
+
+static int
+uni_tiled_source_level_width (UniTiledSource * source, int level)
+{
+    return (source->width + (1 << level) - 1) >> level;
+}
+
+static int
+uni_tiled_source_level_height (UniTiledSource * source, int level)
+{
+    return (source->height + (1 << level) - 1) >> level;
+}
+
+static gsize
+uni_tile_size (GdkPixbuf * pixbuf)
+{
+    return (gsize) gdk_pixbuf_get_rowstride (pixbuf)
+        * gdk_pixbuf_get_height (pixbuf);
+}
+
+static void
+uni_tiled_source_remove_link (UniTiledSource * source, GList * link)
+{
+    UniTile *tile = link->data;
+
+    g_hash_table_remove (source->tiles, &tile->key);
+    source->used -= uni_tile_size (tile->pixbuf);
+    g_queue_delete_link (source->lru, link);
+    g_object_unref (tile->pixbuf);
+    g_slice_free (UniTile, tile);
+}
+
+/* Called with the lock held */
+static void
+uni_tiled_source_store (UniTiledSource * source, gint64 key,
+                        GdkPixbuf * pixbuf)
+{
+    GList *link = g_hash_table_lookup (source->tiles, &key);
+    UniTile *tile;
+
+    if (link != NULL)
+        uni_tiled_source_remove_link (source, link);
+
+    tile = g_slice_new (UniTile);
+    tile->key = key;
+    tile->pixbuf = g_object_ref (pixbuf);
+
+    g_queue_push_head (source->lru, tile);
+    g_hash_table_insert (source->tiles, &tile->key, source->lru->head);
+    source->used += uni_tile_size (pixbuf);
+
+    /* The tile just stored always stays */
+    while (source->used > source->budget
+           && source->lru->tail != source->lru->head)
+        uni_tiled_source_remove_link (source, source->lru->tail);
+}
+
+/* Returns a new reference to a tile if it is cached, %NULL otherwise. */
+static GdkPixbuf *
+uni_tiled_source_lookup (UniTiledSource * source,
+                         int level, int col, int row)
+{
+    gint64 key = uni_tiled_source_key (level, col, row);
+    GdkPixbuf *pixbuf = NULL;
+    GList *link;
+
+    g_mutex_lock (&source->lock);
+    link = g_hash_table_lookup (source->tiles, &key);
+    if (link != NULL)
+    {
+        g_queue_unlink (source->lru, link);
+        g_queue_push_head_link (source->lru, link);
+        pixbuf = g_object_ref (((UniTile *) link->data)->pixbuf);
+    }
+    g_mutex_unlock (&source->lock);
+    return pixbuf;
+}
+
+static GdkPixbuf *uni_tiled_source_get_tile (UniTiledSource * source,
+                                             int level, int col, int row);
+
+/* Builds a tile of @level from the up to four tiles of the level below
+ * that cover the same area. */
+static GdkPixbuf *
+uni_tiled_source_build_tile (UniTiledSource * source,
+                             int level, int col, int row)
+{
+    int below_width = uni_tiled_source_level_width (source, level - 1);
+    int below_height = uni_tiled_source_level_height (source, level - 1);
+    int x = col * 2 * source->tile_width;
+    int y = row * 2 * source->tile_height;
+    int width = MIN (2 * source->tile_width, below_width - x);
+    int height = MIN (2 * source->tile_height, below_height - y);
+    GdkPixbuf *merged, *tile;
+    int i, j;
+
+    merged = gdk_pixbuf_new (GDK_COLORSPACE_RGB, source->has_alpha, 8,
+                             width, height);
+    if (merged == NULL)
+        return NULL;
+
+    for (j = 0; j < 2; j++)
+    {
+        for (i = 0; i < 2; i++)
+        {
+            GdkPixbuf *part;
+
+            if (i * source->tile_width >= width
+                || j * source->tile_height >= height)
+                continue;
+
+            part = uni_tiled_source_get_tile (source, level - 1,
+                                              2 * col + i, 2 * row + j);
+            if (part == NULL)
+            {
+                g_object_unref (merged);
+                return NULL;
+            }
+
+            gdk_pixbuf_copy_area (part, 0, 0,
+                                  gdk_pixbuf_get_width (part),
+                                  gdk_pixbuf_get_height (part),
+                                  merged,
+                                  i * source->tile_width,
+                                  j * source->tile_height);
+            g_object_unref (part);
+        }
+    }
+
+    tile = gdk_pixbuf_scale_simple (merged,
+                                    MAX ((width + 1) / 2, 1),
+                                    MAX ((height + 1) / 2, 1),
+                                    GDK_INTERP_BILINEAR);
+    g_object_unref (merged);
+    return tile;
+}
+
+/* Returns a new reference to a tile, decoding or building it when it
+ * isn't cached. Only one thread at a time may do this. */
+static GdkPixbuf *
+uni_tiled_source_get_tile (UniTiledSource * source,
+                           int level, int col, int row)
+{
+    GdkPixbuf *pixbuf;
+    GError *error = NULL;
+
+    pixbuf = uni_tiled_source_lookup (source, level, col, row);
+    if (pixbuf != NULL)
+        return pixbuf;
+
+    if (level == 0)
+    {
+        pixbuf = source->klass->read_tile (source, col, row, &error);
+        if (pixbuf == NULL)
+        {
+            g_warning ("Failed to read tile %d,%d: %s", col, row,
+                       error ? error->message : "unknown error");
+            g_clear_error (&error);
+            return NULL;
+        }
+    }
+    else
+    {
+        pixbuf = uni_tiled_source_build_tile (source, level, col, row);
+        if (pixbuf == NULL)
+            return NULL;
+    }
+
+    g_mutex_lock (&source->lock);
+    uni_tiled_source_store (source, uni_tiled_source_key (level, col, row),
+                            pixbuf);
+    g_mutex_unlock (&source->lock);
+    return pixbuf;
+}
+
+static gboolean
+uni_tiled_source_loaded_dispatch (UniTileLoaded * loaded)
+{
+    UniTiledSource *source = loaded->source;
+
+    if (source->loaded != NULL)
+        source->loaded (source, &loaded->area, source->loaded_data);
+    return FALSE;
+}
+
+static void
+uni_tiled_source_loaded_free (UniTileLoaded * loaded)
+{
+    uni_tiled_source_unref (loaded->source);
+    g_slice_free (UniTileLoaded, loaded);
+}
+
+/* Tells the main context which part of the image a loaded tile
+ * covers. */
+static void
+uni_tiled_source_post_loaded (UniTiledSource * source, GTask * task,
+                              UniTileRequest * request)
+{
+    int scale = 1 << request->level;
+    UniTileLoaded *loaded;
+
+    loaded = g_slice_new (UniTileLoaded);
+    loaded->source = uni_tiled_source_ref (source);
+    loaded->area.x = request->col * source->tile_width * scale;
+    loaded->area.y = request->row * source->tile_height * scale;
+    loaded->area.width = MIN (source->tile_width * scale,
+                              source->width - loaded->area.x);
+    loaded->area.height = MIN (source->tile_height * scale,
+                               source->height - loaded->area.y);
+
+    g_main_context_invoke_full (g_task_get_context (task),
+                                G_PRIORITY_DEFAULT,
+                                (GSourceFunc) uni_tiled_source_loaded_dispatch,
+                                loaded,
+                                (GDestroyNotify) uni_tiled_source_loaded_free);
+}
+
+/* Loads the wanted tiles, newest first, until there are none left. */
+static void
+uni_tiled_source_load_thread (GTask * task,
+                              gpointer source_object,
+                              gpointer task_data, GCancellable * cancellable)
+{
+    UniTiledSource *source = task_data;
+    UniTileRequest *request;
+    GdkPixbuf *pixbuf;
+
+    for (;;)
+    {
+        g_mutex_lock (&source->lock);
+        request = g_queue_pop_head (source->wanted);
+        if (request == NULL)
+            source->loading = FALSE;
+        g_mutex_unlock (&source->lock);
+
+        if (request == NULL)
+            break;
+
+        /* Asked for again while it was being loaded */
+        pixbuf = uni_tiled_source_lookup (source, request->level,
+                                          request->col, request->row);
+        if (pixbuf == NULL)
+        {
+            pixbuf = uni_tiled_source_get_tile (source, request->level,
+                                                request->col, request->row);
+            if (pixbuf != NULL)
+                uni_tiled_source_post_loaded (source, task, request);
+        }
+
+        if (pixbuf != NULL)
+            g_object_unref (pixbuf);
+        g_slice_free (UniTileRequest, request);
+    }
+    g_task_return_boolean (task, TRUE);
+}
+
+/* Asks for a tile to be loaded in the background. */
+static void
+uni_tiled_source_request (UniTiledSource * source,
+                          int level, int col, int row)
+{
+    UniTileRequest *request;
+    gboolean start;
+    GList *link;
+    GTask *task;
+
+    g_mutex_lock (&source->lock);
+    for (link = source->wanted->head; link != NULL; link = link->next)
+    {
+        request = link->data;
+        if (request->level == level
+            && request->col == col && request->row == row)
+            break;
+    }
+
+    if (link != NULL)
+    {
+        g_queue_unlink (source->wanted, link);
+        g_queue_push_head_link (source->wanted, link);
+    }
+    else
+    {
+        request = g_slice_new (UniTileRequest);
+        request->level = level;
+        request->col = col;
+        request->row = row;
+        g_queue_push_head (source->wanted, request);
+
+        if (source->wanted->length > UNI_TILED_SOURCE_MAX_WANTED)
+            g_slice_free (UniTileRequest, g_queue_pop_tail (source->wanted));
+    }
+
+    start = !source->loading;
+    source->loading = TRUE;
+    g_mutex_unlock (&source->lock);
+
+    if (!start)
+        return;
+
+    task = g_task_new (NULL, NULL, NULL, NULL);
+    g_task_set_task_data (task, uni_tiled_source_ref (source),
+                          (GDestroyNotify) uni_tiled_source_unref);
+    g_task_run_in_thread (task, uni_tiled_source_load_thread);
+    g_object_unref (task);
+}
+
+/* Returns a new reference to a tile, or %NULL if it isn't there. With
+ * @wait it is loaded right away, otherwise in the background. */
+static GdkPixbuf *
+uni_tiled_source_fetch (UniTiledSource * source,
+                        int level, int col, int row, gboolean wait)
+{
+    GdkPixbuf *pixbuf;
+
+    if (wait)
+        return uni_tiled_source_get_tile (source, level, col, row);
+
+    pixbuf = uni_tiled_source_lookup (source, level, col, row);
+    if (pixbuf == NULL)
+        uni_tiled_source_request (source, level, col, row);
+    return pixbuf;
+}
+
+/* Copies @region of @level into a new pixbuf, so that tile (@col,
+ * @row) can be scaled along with the edges of its neighbours. Returns
+ * %NULL if that tile isn't there or memory ran out. Neighbours that
+ * aren't there leave their part blank. */
+static GdkPixbuf *
+uni_tiled_source_merge (UniTiledSource * source, int level,
+                        GdkRectangle * region,
+                        int col, int row, gboolean wait)
+{
+    GdkPixbuf *tile, *merged;
+    int c, r;
+
+    tile = uni_tiled_source_fetch (source, level, col, row, wait);
+    if (tile == NULL)
+        return NULL;
+
+    merged = gdk_pixbuf_new (GDK_COLORSPACE_RGB, source->has_alpha, 8,
+                             region->width, region->height);
+    if (merged == NULL)
+    {
+        g_object_unref (tile);
+        return NULL;
+    }
+    gdk_pixbuf_fill (merged, 0);
+
+    for (r = region->y / source->tile_height;
+         r <= (region->y + region->height - 1) / source->tile_height; r++)
+    {
+        for (c = region->x / source->tile_width;
+             c <= (region->x + region->width - 1) / source->tile_width; c++)
+        {
+            GdkRectangle part;
+            GdkPixbuf *pixbuf;
+
+            if (c == col && r == row)
+                pixbuf = g_object_ref (tile);
+            else
+                pixbuf = uni_tiled_source_fetch (source, level, c, r, wait);
+            if (pixbuf == NULL)
+                continue;
+
+            part.x = c * source->tile_width;
+            part.y = r * source->tile_height;
+            part.width = gdk_pixbuf_get_width (pixbuf);
+            part.height = gdk_pixbuf_get_height (pixbuf);
+
+            if (gdk_rectangle_intersect (region, &part, &part))
+                gdk_pixbuf_copy_area (pixbuf,
+                                      part.x - c * source->tile_width,
+                                      part.y - r * source->tile_height,
+                                      part.width, part.height,
+                                      merged,
+                                      part.x - region->x,
+                                      part.y - region->y);
+            g_object_unref (pixbuf);
+        }
+    }
+
+    g_object_unref (tile);
+    return merged;
+}
+
+static void
+uni_tiled_source_scale (GdkPixbuf * src,
+                        GdkPixbuf * dst,
+                        GdkRectangle * area,
+                        gdouble offset_x,
+                        gdouble offset_y,
+                        gdouble zoom,
+                        GdkInterpType interp,
+                        gboolean blend, int check_x, int check_y)
+{
+    if (blend)
+        uni_pixbuf_scale_blend (src, dst,
+                                area->x, area->y, area->width, area->height,
+                                offset_x, offset_y, zoom,
+                                interp, check_x, check_y);
+    else
+        gdk_pixbuf_scale (src, dst,
+                          area->x, area->y, area->width, area->height,
+                          offset_x, offset_y, zoom, zoom, interp);
+}
+
+/* Stands in for tile (@col, @row) of @level, which isn't there yet,
+ * with the closest coarser tile that is, or else the rendition. */
+static void
+uni_tiled_source_draw_fallback (UniTiledSource * source,
+                                GdkPixbuf * dst,
+                                GdkRectangle * area,
+                                int level, int col, int row,
+                                gdouble offset_x,
+                                gdouble offset_y,
+                                gdouble zoom,
+                                GdkInterpType interp,
+                                gboolean blend, int check_x, int check_y)
+{
+    GdkPixbuf *pixbuf = NULL;
+    gdouble x = offset_x, y = offset_y, pixbuf_zoom = 0.0;
+    int up;
+
+    for (up = level + 1; up <= source->n_levels && pixbuf == NULL; up++)
+    {
+        int shift = up - level;
+
+        pixbuf = uni_tiled_source_lookup (source, up,
+                                          col >> shift, row >> shift);
+        if (pixbuf != NULL)
+        {
+            pixbuf_zoom = zoom * (1 << up);
+            x += (col >> shift) * source->tile_width * pixbuf_zoom;
+            y += (row >> shift) * source->tile_height * pixbuf_zoom;
+        }
+    }
+
+    if (pixbuf == NULL && source->rendition != NULL)
+    {
+        pixbuf = g_object_ref (source->rendition);
+        pixbuf_zoom = zoom * source->width / gdk_pixbuf_get_width (pixbuf);
+    }
+
+    if (pixbuf == NULL)
+        return;
+
+    uni_tiled_source_scale (pixbuf, dst, area, x, y, pixbuf_zoom,
+                            interp, blend, check_x, check_y);
+    g_object_unref (pixbuf);
+}
+
+/* Draws the tiles that cover the destination area, taken from the
+ * level closest to the wanted resolution that is not below it. Returns
+ * %FALSE if @cancellable was cancelled before all of them were. */
+static gboolean
+uni_tiled_source_draw (UniTiledSource * source,
+                       GdkPixbuf * dst,
+                       GdkRectangle * dst_area,
+                       gdouble offset_x,
+                       gdouble offset_y,
+                       gdouble zoom,
+                       GdkInterpType interp,
+                       gboolean blend, int check_x, int check_y,
+                       gboolean wait, GCancellable * cancellable)
+{
+    int level = 0;
+    gdouble level_zoom;
+    int level_width, level_height;
+    int x0, y0, x1, y1;
+    int col0, col1, row0, row1, col, row;
+
+    while (level < source->n_levels && zoom * (2 << level) <= 1.0)
+        level++;
+
+    level_zoom = zoom * (1 << level);
+    level_width = uni_tiled_source_level_width (source, level);
+    level_height = uni_tiled_source_level_height (source, level);
+
+    /* Part of the level the area shows, plus the border */
+    x0 = (int) floor ((dst_area->x - offset_x) / level_zoom);
+    y0 = (int) floor ((dst_area->y - offset_y) / level_zoom);
+    x1 = (int) ceil ((dst_area->x + dst_area->width - offset_x) / level_zoom);
+    y1 = (int) ceil ((dst_area->y + dst_area->height - offset_y) / level_zoom);
+
+    x0 = MAX (x0 - UNI_TILED_SOURCE_BORDER, 0);
+    y0 = MAX (y0 - UNI_TILED_SOURCE_BORDER, 0);
+    x1 = MIN (x1 + UNI_TILED_SOURCE_BORDER, level_width);
+    y1 = MIN (y1 + UNI_TILED_SOURCE_BORDER, level_height);
+    if (x0 >= x1 || y0 >= y1)
+        return TRUE;
+
+    col0 = x0 / source->tile_width;
+    row0 = y0 / source->tile_height;
+    col1 = (x1 - 1) / source->tile_width;
+    row1 = (y1 - 1) / source->tile_height;
+
+    for (row = row0; row <= row1; row++)
+    {
+        for (col = col0; col <= col1; col++)
+        {
+            int left = col * source->tile_width;
+            int top = row * source->tile_height;
+            int right = MIN (left + source->tile_width, level_width);
+            int bottom = MIN (top + source->tile_height, level_height);
+            GdkRectangle area, region;
+            GdkPixbuf *merged;
+
+            area.x = (int) floor (offset_x + left * level_zoom);
+            area.y = (int) floor (offset_y + top * level_zoom);
+            area.width = (int) ceil (offset_x + right * level_zoom) - area.x;
+            area.height = (int) ceil (offset_y + bottom * level_zoom) - area.y;
+            if (!gdk_rectangle_intersect (dst_area, &area, &area))
+                continue;
+
+            region.x = MAX (left - UNI_TILED_SOURCE_BORDER, x0);
+            region.y = MAX (top - UNI_TILED_SOURCE_BORDER, y0);
+            region.width = MIN (right + UNI_TILED_SOURCE_BORDER, x1) - region.x;
+            region.height = MIN (bottom + UNI_TILED_SOURCE_BORDER, y1) - region.y;
+
+            merged = uni_tiled_source_merge (source, level, &region,
+                                             col, row, wait);
+            if (merged != NULL)
+            {
+                uni_tiled_source_scale (merged, dst, &area,
+                                        offset_x + region.x * level_zoom,
+                                        offset_y + region.y * level_zoom,
+                                        level_zoom,
+                                        interp, blend, check_x, check_y);
+                g_object_unref (merged);
+            }
+            else
+                uni_tiled_source_draw_fallback (source, dst, &area,
+                                                level, col, row,
+                                                offset_x, offset_y, zoom,
+                                                interp, blend,
+                                                check_x, check_y);
+
+            if (g_cancellable_is_cancelled (cancellable))
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*************************************************************/
+/***** Actions ***********************************************/
+/*************************************************************/
+
+/**
+ * uni_tiled_source_new:
+ * @klass: the backend reading the tiles
+ * @priv: data of the backend, freed by @klass->finalize
+ * @width: width of the image
+ * @height: height of the image
+ * @has_alpha: whether tiles come with an alpha channel
+ * @tile_width: width of the tiles the backend reads
+ * @tile_height: height of those tiles
+ * @returns: a new #UniTiledSource
+ **/
+UniTiledSource *
+uni_tiled_source_new (const UniTiledSourceClass * klass,
+                      gpointer priv,
+                      int width, int height,
+                      gboolean has_alpha,
+                      int tile_width, int tile_height)
+{
+    UniTiledSource *source = g_new0 (UniTiledSource, 1);
+
+    source->ref_count = 1;
+    source->klass = klass;
+    source->priv = priv;
+    source->width = width;
+    source->height = height;
+    source->has_alpha = has_alpha;
+    source->tile_width = tile_width;
+    source->tile_height = tile_height;
+
+    while (uni_tiled_source_level_width (source, source->n_levels) > tile_width
+           || uni_tiled_source_level_height (source, source->n_levels) > tile_height)
+        source->n_levels++;
+
+    g_mutex_init (&source->lock);
+    source->tiles = g_hash_table_new (g_int64_hash, g_int64_equal);
+    source->lru = g_queue_new ();
+    source->budget = UNI_TILED_SOURCE_BUDGET;
+    source->wanted = g_queue_new ();
+
+    return source;
+}
+
+UniTiledSource *
+uni_tiled_source_ref (UniTiledSource * source)
+{
+    g_atomic_int_inc (&source->ref_count);
+    return source;
+}
+
+void
+uni_tiled_source_unref (UniTiledSource * source)
+{
+    if (!g_atomic_int_dec_and_test (&source->ref_count))
+        return;
+
+    while (!g_queue_is_empty (source->lru))
+        uni_tiled_source_remove_link (source, source->lru->head);
+
+    while (!g_queue_is_empty (source->wanted))
+        g_slice_free (UniTileRequest, g_queue_pop_head (source->wanted));
+
+    if (source->klass->finalize)
+        source->klass->finalize (source);
+
+    if (source->rendition)
+        g_object_unref (source->rendition);
+
+    g_hash_table_destroy (source->tiles);
+    g_queue_free (source->lru);
+    g_queue_free (source->wanted);
+    g_mutex_clear (&source->lock);
+    g_free (source);
+}
+
+/**
+ * uni_tiled_source_add_tile:
+ * @source: a #UniTiledSource
+ * @col: column of the tile in the full resolution grid
+ * @row: row of the tile
+ * @pixbuf: the tile
+ *
+ * Stores a full resolution tile that was decoded along with the one
+ * asked for, so that it needn't be decoded again later.
+ **/
+void
+uni_tiled_source_add_tile (UniTiledSource * source,
+                           int col, int row, GdkPixbuf * pixbuf)
+{
+    g_mutex_lock (&source->lock);
+    uni_tiled_source_store (source, uni_tiled_source_key (0, col, row),
+                            pixbuf);
+    g_mutex_unlock (&source->lock);
+}
+
+/**
+ * uni_tiled_source_set_loaded_func:
+ * @source: a #UniTiledSource
+ * @func: function to call when a tile is loaded, or %NULL
+ * @data: data to pass to @func
+ *
+ * Sets the function that is called on the main thread with the area
+ * of the image, at full resolution, that a tile loaded in the
+ * background covers. That area was drawn with a stand-in before and
+ * should be drawn again.
+ *
+ * Setting %NULL also drops the tiles that are asked for but not
+ * loaded yet, since nobody is going to draw them.
+ **/
+void
+uni_tiled_source_set_loaded_func (UniTiledSource * source,
+                                  UniTiledSourceFunc func, gpointer data)
+{
+    source->loaded = func;
+    source->loaded_data = data;
+
+    if (func != NULL)
+        return;
+
+    g_mutex_lock (&source->lock);
+    while (!g_queue_is_empty (source->wanted))
+        g_slice_free (UniTileRequest, g_queue_pop_head (source->wanted));
+    g_mutex_unlock (&source->lock);
+}
+
+/**
+ * uni_tiled_source_scale_blend:
+ *
+ * Works like uni_pixbuf_scale_blend() with @source as the source
+ * image, @zoom being relative to its full resolution. Only the tiles
+ * that cover the destination area are used; those that aren't loaded
+ * yet are asked for and drawn from a stand-in meanwhile.
+ **/
+void
+uni_tiled_source_scale_blend (UniTiledSource * source,
+                              GdkPixbuf * dst,
+                              int dst_x,
+                              int dst_y,
+                              int dst_width,
+                              int dst_height,
+                              gdouble offset_x,
+                              gdouble offset_y,
+                              gdouble zoom,
+                              GdkInterpType interp,
+                              int check_x, int check_y)
+{
+    GdkRectangle area = { dst_x, dst_y, dst_width, dst_height };
+
+    uni_tiled_source_draw (source, dst, &area, offset_x, offset_y, zoom,
+                           interp, TRUE, check_x, check_y, FALSE, NULL);
+}
+
+/**
+ * uni_tiled_source_render:
+ * @source: a #UniTiledSource
+ * @width: width of the rendition
+ * @height: height of the rendition
+ * @cancellable: a #GCancellable, or %NULL
+ * @returns: a new pixbuf holding the whole image scaled to @width
+ *   by @height, alpha channel included, or %NULL if memory ran out or
+ *   @cancellable was cancelled.
+ *
+ * Reads all the tiles needed right away. The rendition is kept to
+ * stand in for tiles that aren't loaded yet when drawing.
+ **/
+GdkPixbuf *
+uni_tiled_source_render (UniTiledSource * source, int width, int height,
+                         GCancellable * cancellable)
+{
+    GdkRectangle area = { 0, 0, width, height };
+    GdkPixbuf *pixbuf;
+
+    pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, source->has_alpha, 8,
+                             width, height);
+    if (pixbuf == NULL)
+        return NULL;
+
+    gdk_pixbuf_fill (pixbuf, 0);
+    if (!uni_tiled_source_draw (source, pixbuf, &area, 0.0, 0.0,
+                                (gdouble) width / source->width,
+                                GDK_INTERP_BILINEAR, FALSE, 0, 0,
+                                TRUE, cancellable))
+    {
+        g_object_unref (pixbuf);
+        return NULL;
+    }
+
+    if (source->rendition)
+        g_object_unref (source->rendition);
+    source->rendition = g_object_ref (pixbuf);
+    return pixbuf;
+}
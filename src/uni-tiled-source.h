@@ -0,0 +1,139 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UNI_TILED_SOURCE_H__
+#define __UNI_TILED_SOURCE_H__
+
+#include <gdk/gdk.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _UniTiledSource UniTiledSource;
+typedef struct _UniTiledSourceClass UniTiledSourceClass;
+
+typedef void (*UniTiledSourceFunc) (UniTiledSource * source,
+                                    GdkRectangle * area, gpointer data);
+
+/**
+ * UniTiledSourceClass:
+ * @read_tile: decodes tile (@col, @row) of the full resolution grid and
+ *   returns it, or %NULL with @error set. Tiles at the right and bottom
+ *   edges are cut to the image size. Backends that decode neighbouring
+ *   tiles in the same go may hand them to uni_tiled_source_add_tile().
+ * @finalize: frees the backend data
+ **/
+struct _UniTiledSourceClass {
+    GdkPixbuf * (*read_tile) (UniTiledSource * source,
+                              int col, int row, GError ** error);
+    void (*finalize) (UniTiledSource * source);
+};
+
+/**
+ * UniTiledSource:
+ *
+ * An image too large to be held in one #GdkPixbuf. Tiles are decoded
+ * on demand when a part of the image is drawn, and scaled down tiles
+ * are built from the ones below them, so that drawing a zoomed out
+ * view doesn't have to sample full resolution tiles each time. Only a
+ * bounded number of tiles is kept around; the least recently used
+ * ones are dropped first.
+ *
+ * Drawing never waits for a tile. Missing tiles are loaded on a worker
+ * thread, one at a time, while a coarser tile or the rendition stands
+ * in for them; the function given to uni_tiled_source_set_loaded_func()
+ * is told when they are in.
+ *
+ * Drawing must happen on the main thread. uni_tiled_source_render()
+ * reads tiles right away and is meant for the thread that opens the
+ * source, before it is drawn.
+ **/
+struct _UniTiledSource {
+    int ref_count;
+    const UniTiledSourceClass *klass;
+    gpointer priv;
+
+    /* Size of the image at full resolution */
+    int width;
+    int height;
+    gboolean has_alpha;
+
+    /* Size of the tiles at every level */
+    int tile_width;
+    int tile_height;
+
+    /* Level at which the whole image fits into one tile */
+    int n_levels;
+
+    /* Guards the tiles and the requests, which the loading thread
+     * shares with the drawing one */
+    GMutex lock;
+
+    /* Key -> GList link in @lru */
+    GHashTable *tiles;
+    GQueue *lru;
+    gsize used;
+    gsize budget;
+
+    /* Tiles asked for but not loaded yet, newest first, and whether
+     * a thread is working through them */
+    GQueue *wanted;
+    gboolean loading;
+
+    /* The whole image scaled down, as last rendered */
+    GdkPixbuf *rendition;
+
+    UniTiledSourceFunc loaded;
+    gpointer loaded_data;
+};
+
+UniTiledSource* uni_tiled_source_new        (const UniTiledSourceClass * klass,
+                                             gpointer priv,
+                                             int width, int height,
+                                             gboolean has_alpha,
+                                             int tile_width, int tile_height);
+UniTiledSource* uni_tiled_source_ref        (UniTiledSource * source);
+void            uni_tiled_source_unref      (UniTiledSource * source);
+
+void            uni_tiled_source_add_tile   (UniTiledSource * source,
+                                             int col, int row,
+                                             GdkPixbuf * pixbuf);
+
+void            uni_tiled_source_scale_blend (UniTiledSource * source,
+                                              GdkPixbuf * dst,
+                                              int dst_x,
+                                              int dst_y,
+                                              int dst_width,
+                                              int dst_height,
+                                              gdouble offset_x,
+                                              gdouble offset_y,
+                                              gdouble zoom,
+                                              GdkInterpType interp,
+                                              int check_x, int check_y);
+
+void            uni_tiled_source_set_loaded_func (UniTiledSource * source,
+                                                  UniTiledSourceFunc func,
+                                                  gpointer data);
+
+GdkPixbuf*      uni_tiled_source_render     (UniTiledSource * source,
+                                             int width, int height,
+                                             GCancellable * cancellable);
+
+G_END_DECLS
+#endif /* __UNI_TILED_SOURCE_H__ */
@@ -21,13 +21,133 @@
  */
 
 #include "uni-utils.h"
+#include "uni-scale.h"
+
+/* Paint rectangles smaller than this many pixels are not worth
+ * handing to other threads. */
+#define UNI_SCALE_MIN_PIXELS (256 * 256)
+
+/* Height of the smallest band given to a thread */
+#define UNI_SCALE_MIN_BAND 32
+
+typedef struct {
+    GdkPixbuf *src;
+    GdkPixbuf *dst;
+    int dst_x;
+    int dst_y;
+    int dst_width;
+    int dst_height;
+    gdouble offset_x;
+    gdouble offset_y;
+    gdouble zoom;
+    GdkInterpType interp;
+    int check_x;
+    int check_y;
+
+    /* Shared by all bands of one call */
+    GMutex *lock;
+    GCond *done;
+    int *pending;
+} UniScaleBand;
+
+static void
+uni_pixbuf_scale_blend_band (UniScaleBand * band)
+{
+    if (uni_pixbuf_scale_fast (band->src, band->dst,
+                               band->dst_x, band->dst_y,
+                               band->dst_width, band->dst_height,
+                               band->offset_x, band->offset_y, band->zoom,
+                               band->interp, band->check_x, band->check_y))
+        return;
+
+    /* Scaling and then flattening is several times faster than
+       gdk_pixbuf_composite_color() doing both at once. */
+    if (gdk_pixbuf_get_has_alpha (band->src))
+    {
+        GdkPixbuf *scaled = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8,
+                                            band->dst_width,
+                                            band->dst_height);
+        if (scaled != NULL)
+        {
+            gboolean blended;
+
+            gdk_pixbuf_scale (band->src, scaled,
+                              0, 0, band->dst_width, band->dst_height,
+                              band->offset_x - band->dst_x,
+                              band->offset_y - band->dst_y,
+                              band->zoom, band->zoom, band->interp);
+            blended = uni_pixbuf_blend_checks (scaled, band->dst,
+                                               band->dst_x, band->dst_y,
+                                               band->check_x,
+                                               band->check_y);
+            g_object_unref (scaled);
+            if (blended)
+                return;
+        }
+    }
+
+    if (gdk_pixbuf_get_has_alpha (band->src))
+        gdk_pixbuf_composite_color (band->src, band->dst,
+                                    band->dst_x, band->dst_y,
+                                    band->dst_width, band->dst_height,
+                                    band->offset_x, band->offset_y,
+                                    band->zoom, band->zoom,
+                                    band->interp,
+                                    255,
+                                    band->check_x, band->check_y,
+                                    CHECK_SIZE, CHECK_LIGHT, CHECK_DARK);
+    else
+        gdk_pixbuf_scale (band->src, band->dst,
+                          band->dst_x, band->dst_y,
+                          band->dst_width, band->dst_height,
+                          band->offset_x, band->offset_y,
+                          band->zoom, band->zoom, band->interp);
+}
+
+static void
+uni_pixbuf_scale_blend_worker (UniScaleBand * band, gpointer unused)
+{
+    uni_pixbuf_scale_blend_band (band);
+
+    g_mutex_lock (band->lock);
+    if (--*band->pending == 0)
+        g_cond_signal (band->done);
+    g_mutex_unlock (band->lock);
+}
+
+/* The pool the bands are scaled on, or NULL on a single core. The
+ * calling thread always takes a band itself, so the pool has one
+ * thread less than there are processors. */
+static GThreadPool *
+uni_pixbuf_scale_pool (void)
+{
+    static gsize pool = 0;
+
+    if (g_once_init_enter (&pool))
+    {
+        GThreadPool *new_pool = NULL;
+        int threads = (int) g_get_num_processors () - 1;
+
+        if (threads > 0)
+            new_pool = g_thread_pool_new ((GFunc) uni_pixbuf_scale_blend_worker,
+                                          NULL, threads, FALSE, NULL);
+        g_once_init_leave (&pool, (gsize) new_pool | 1);
+    }
+    return (GThreadPool *) (pool & ~(gsize) 1);
+}
 
 /**
  * uni_pixbuf_scale_blend:
  *
  * A utility function that either scales or composites color depending
  * on the number of channels in the source image. The last four
- * parameters are only used in the composite color case.
+ * parameters are only used in the composite color case. Common cases
+ * are drawn by uni_pixbuf_scale_fast(), the rest by gdk-pixbuf.
+ *
+ * Large rectangles are split into horizontal bands that are scaled
+ * on all processors at once. Every destination pixel is computed
+ * from its absolute position alone, so the result is the same as
+ * scaling the whole rectangle in one go.
  **/
 void
 uni_pixbuf_scale_blend (GdkPixbuf * src,
@@ -41,19 +161,105 @@ uni_pixbuf_scale_blend (GdkPixbuf * src,
                         gdouble zoom,
                         GdkInterpType interp, int check_x, int check_y)
 {
-    if (gdk_pixbuf_get_has_alpha (src))
-        gdk_pixbuf_composite_color (src, dst,
-                                    dst_x, dst_y, dst_width, dst_height,
-                                    offset_x, offset_y,
-                                    zoom, zoom,
-                                    interp,
-                                    255,
-                                    check_x, check_y,
-                                    CHECK_SIZE, CHECK_LIGHT, CHECK_DARK);
-    else
-        gdk_pixbuf_scale (src, dst,
-                          dst_x, dst_y, dst_width, dst_height,
-                          offset_x, offset_y, zoom, zoom, interp);
+    UniScaleBand whole = { src, dst, dst_x, dst_y, dst_width, dst_height,
+                           offset_x, offset_y, zoom, interp,
+                           check_x, check_y, NULL, NULL, NULL };
+    GThreadPool *pool = NULL;
+    UniScaleBand *bands;
+    GMutex lock;
+    GCond done;
+    int n_bands, pending, n;
+
+    if (dst_width * dst_height >= UNI_SCALE_MIN_PIXELS)
+        pool = uni_pixbuf_scale_pool ();
+
+    if (pool == NULL)
+    {
+        uni_pixbuf_scale_blend_band (&whole);
+        return;
+    }
+
+    n_bands = MIN ((int) g_thread_pool_get_max_threads (pool) + 1,
+                   dst_height / UNI_SCALE_MIN_BAND);
+    if (n_bands < 2)
+    {
+        uni_pixbuf_scale_blend_band (&whole);
+        return;
+    }
+
+    g_mutex_init (&lock);
+    g_cond_init (&done);
+    pending = n_bands - 1;
+
+    bands = g_new (UniScaleBand, n_bands);
+    for (n = 0; n < n_bands; n++)
+    {
+        int top = n * dst_height / n_bands;
+        int bottom = (n + 1) * dst_height / n_bands;
+
+        bands[n] = whole;
+        bands[n].dst_y = dst_y + top;
+        bands[n].dst_height = bottom - top;
+        /* The checkerboard origin is relative to the painted area */
+        bands[n].check_y = check_y + top;
+        bands[n].lock = &lock;
+        bands[n].done = &done;
+        bands[n].pending = &pending;
+    }
+
+    for (n = 1; n < n_bands; n++)
+        g_thread_pool_push (pool, &bands[n], NULL);
+    uni_pixbuf_scale_blend_band (&bands[0]);
+
+    g_mutex_lock (&lock);
+    while (pending > 0)
+        g_cond_wait (&done, &lock);
+    g_mutex_unlock (&lock);
+
+    g_free (bands);
+    g_cond_clear (&done);
+    g_mutex_clear (&lock);
+}
+
+/**
+ * uni_pixbuf_apply_orientation:
+ * @pixbuf: a pixbuf as stored in the file
+ * @orientation: an EXIF orientation, 1 to 8
+ * @returns: a new reference to @pixbuf turned the way @orientation
+ *   says it is to be shown, or %NULL if there is not enough memory.
+ *
+ * Like gdk_pixbuf_apply_embedded_orientation(), but with the
+ * orientation given explicitly.
+ **/
+GdkPixbuf *
+uni_pixbuf_apply_orientation (GdkPixbuf * pixbuf, int orientation)
+{
+    GdkPixbuf *tmp, *result;
+
+    switch (orientation)
+    {
+    case 2:
+        return gdk_pixbuf_flip (pixbuf, TRUE);
+    case 3:
+        return gdk_pixbuf_rotate_simple (pixbuf, GDK_PIXBUF_ROTATE_UPSIDEDOWN);
+    case 4:
+        return gdk_pixbuf_flip (pixbuf, FALSE);
+    case 5:
+    case 7:
+        tmp = gdk_pixbuf_rotate_simple (pixbuf, GDK_PIXBUF_ROTATE_CLOCKWISE);
+        if (tmp == NULL)
+            return NULL;
+        result = gdk_pixbuf_flip (tmp, orientation == 5);
+        g_object_unref (tmp);
+        return result;
+    case 6:
+        return gdk_pixbuf_rotate_simple (pixbuf, GDK_PIXBUF_ROTATE_CLOCKWISE);
+    case 8:
+        return gdk_pixbuf_rotate_simple (pixbuf,
+                                         GDK_PIXBUF_ROTATE_COUNTERCLOCKWISE);
+    default:
+        return g_object_ref (pixbuf);
+    }
 }
 
 /**
@@ -29,6 +29,9 @@
 #define CHECK_LIGHT 0x00cccccc
 #define CHECK_DARK  0x00808080
 
+/* Whether an EXIF orientation swaps width and height */
+#define UNI_ORIENTATION_IS_TRANSPOSED(o) ((o) >= 5 && (o) <= 8)
+
 typedef struct {
     int width;
     int height;
@@ -45,6 +48,9 @@ void    uni_pixbuf_scale_blend          (GdkPixbuf * src,
                                          gdouble zoom,
                                          GdkInterpType interp, int check_x, int check_y);
 
+GdkPixbuf*  uni_pixbuf_apply_orientation (GdkPixbuf * pixbuf,
+                                         int orientation);
+
 void    uni_draw_rect                   (GdkDrawable * drawable,
                                          GdkGC * gc, gboolean filled, GdkRectangle * rect);
 
@@ -0,0 +1,398 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "config.h"
+
+#include <string.h>
+#include "vnr-decoder.h"
+#include "vnr-tiff.h"
+#include "vnr-jpeg.h"
+
+/* Data is fed to the pixbuf loader in chunks of this size, so that a
+ * cancelled decode stops early and partial results can be shown. */
+#define VNR_DECODER_CHUNK_SIZE (64 * 1024)
+
+/* State of one decode through gdk-pixbuf */
+typedef struct {
+    VnrDecodeRequest *request;
+    GdkPixbuf *pixbuf;
+    GdkRectangle damage;
+} VnrPixbufDecode;
+
+/*************************************************************/
+/***** gdk-pixbuf ********************************************/
+/*************************************************************/
+
+static void
+vnr_pixbuf_size_prepared_cb (GdkPixbufLoader *loader,
+                             gint width, gint height,
+                             VnrPixbufDecode *decode)
+{
+    VnrDecodeRequest *request = decode->request;
+    GdkPixbufFormat *format = gdk_pixbuf_loader_get_format (loader);
+    gchar *name;
+    gboolean animated;
+    gdouble scale;
+
+    request->full_width = width;
+    request->full_height = height;
+
+    /* The loader turns scaled animations into static images, so leave
+     * formats that may be animated alone. */
+    name = format ? gdk_pixbuf_format_get_name (format) : NULL;
+    animated = name == NULL || g_strcmp0 (name, "gif") == 0
+               || g_strcmp0 (name, "ani") == 0 || g_strcmp0 (name, "webp") == 0;
+    g_free (name);
+
+    if (animated)
+        return;
+
+    /* The orientation is not known yet. Scale so that the result still
+     * covers the target if it ends up turned by 90 degrees. */
+    scale = MAX (MIN ((gdouble) request->max_width / width,
+                      (gdouble) request->max_height / height),
+                 MIN ((gdouble) request->max_width / height,
+                      (gdouble) request->max_height / width));
+
+    /* Zooming in past a reduced image means decoding it again, which
+     * only pays off if the reduction saves most of the memory. */
+    if (scale * scale > 0.5)
+        return;
+
+    /* Loaders that support it, JPEG among them, decode at the reduced
+     * size directly instead of scaling the full image down. */
+    gdk_pixbuf_loader_set_size (loader,
+                                MAX ((gint) (width * scale + 0.5), 1),
+                                MAX ((gint) (height * scale + 0.5), 1));
+}
+
+static void
+vnr_pixbuf_area_prepared_cb (GdkPixbufLoader *loader, VnrPixbufDecode *decode)
+{
+    GdkPixbuf *pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+
+    /* Nothing has been written to the pixbuf yet. Clear it, so that
+     * the rows still to come don't show whatever was in memory. */
+    gdk_pixbuf_fill (pixbuf, 0x00000000);
+    decode->pixbuf = g_object_ref (pixbuf);
+}
+
+static void
+vnr_pixbuf_area_updated_cb (GdkPixbufLoader *loader,
+                            gint x, gint y, gint width, gint height,
+                            VnrPixbufDecode *decode)
+{
+    GdkRectangle area = { x, y, width, height };
+
+    if (decode->damage.width == 0 || decode->damage.height == 0)
+        decode->damage = area;
+    else
+        gdk_rectangle_union (&decode->damage, &area, &decode->damage);
+}
+
+/* The loader emits ::area-updated for every few rows, so updates are
+ * merged per chunk instead of being posted one by one. */
+static void
+vnr_pixbuf_flush_progress (VnrPixbufDecode *decode)
+{
+    if (decode->pixbuf == NULL
+        || decode->damage.width == 0 || decode->damage.height == 0)
+        return;
+
+    vnr_decoder_post_progress (decode->request, decode->pixbuf, &decode->damage);
+    decode->damage.width = decode->damage.height = 0;
+}
+
+/* Takes anything gdk-pixbuf has a loader for. The loader sniffs the
+ * format from the data itself, so there is no need to go back to the
+ * file for it.
+ *
+ * Partial results are passed on while the pixbuf is still being filled
+ * in. The main thread may then read rows that are being written at the
+ * same time; those rows are damaged again by a later update, so what
+ * ends up on screen is always complete. */
+static GdkPixbufAnimation *
+vnr_pixbuf_decode (VnrDecodeRequest *request, GError **error)
+{
+    VnrPixbufDecode decode = { request, NULL, { 0, 0, 0, 0 } };
+    GdkPixbufLoader *loader;
+    GdkPixbufAnimation *anim = NULL;
+    gsize length, written = 0;
+    const guchar *buf = g_bytes_get_data (request->data, &length);
+
+    loader = gdk_pixbuf_loader_new ();
+
+    if (request->max_width > 0 && request->max_height > 0)
+        g_signal_connect (loader, "size-prepared",
+                          G_CALLBACK (vnr_pixbuf_size_prepared_cb), &decode);
+
+    if (request->progress != NULL)
+    {
+        g_signal_connect (loader, "area-prepared",
+                          G_CALLBACK (vnr_pixbuf_area_prepared_cb), &decode);
+        g_signal_connect (loader, "area-updated",
+                          G_CALLBACK (vnr_pixbuf_area_updated_cb), &decode);
+    }
+
+    while (written < length)
+    {
+        gsize chunk = MIN (length - written, VNR_DECODER_CHUNK_SIZE);
+
+        if (g_cancellable_set_error_if_cancelled (request->cancellable, error)
+            || !gdk_pixbuf_loader_write (loader, buf + written, chunk, error))
+        {
+            gdk_pixbuf_loader_close (loader, NULL);
+            goto out;
+        }
+
+        written += chunk;
+        vnr_pixbuf_flush_progress (&decode);
+    }
+
+    if (gdk_pixbuf_loader_close (loader, error))
+    {
+        anim = gdk_pixbuf_loader_get_animation (loader);
+        if (anim != NULL)
+            g_object_ref (anim);
+        request->format = gdk_pixbuf_loader_get_format (loader);
+    }
+
+out:
+    if (decode.pixbuf)
+        g_object_unref (decode.pixbuf);
+    g_object_unref (loader);
+    return anim;
+}
+
+static const VnrDecoder vnr_pixbuf_decoder = {
+    "gdk-pixbuf",
+    NULL,
+    VNR_DECODER_SCALED | VNR_DECODER_STREAMING,
+    vnr_pixbuf_decode
+};
+
+/*************************************************************/
+/***** Registry **********************************************/
+/*************************************************************/
+
+/* Backends in order of preference, fastest first. gdk-pixbuf comes
+ * last and takes whatever the others pass on. */
+static const VnrDecoder *vnr_decoders[] = {
+#ifdef HAVE_LIBTIFF
+    &vnr_tiff_decoder,
+#endif
+#ifdef HAVE_LIBJPEG
+    &vnr_jpeg_decoder,
+#endif
+    &vnr_pixbuf_decoder,
+};
+
+static gchar *
+vnr_decoder_guess_mime_type (VnrDecodeRequest *request)
+{
+    const guchar *data = NULL;
+    gsize length = 0;
+    gchar *content_type, *mime_type;
+
+    if (request->data != NULL)
+        data = g_bytes_get_data (request->data, &length);
+
+    content_type = g_content_type_guess (request->path, data, length, NULL);
+    mime_type = g_content_type_get_mime_type (content_type);
+    g_free (content_type);
+
+    return mime_type;
+}
+
+static gboolean
+vnr_decoder_handles (const VnrDecoder *decoder, const gchar *mime_type)
+{
+    gint i;
+
+    if (decoder->mime_types == NULL)
+        return TRUE;
+
+    for (i = 0; mime_type != NULL && decoder->mime_types[i] != NULL; i++)
+        if (g_strcmp0 (decoder->mime_types[i], mime_type) == 0)
+            return TRUE;
+
+    return FALSE;
+}
+
+/*************************************************************/
+/***** Actions ***********************************************/
+/*************************************************************/
+
+/**
+ * vnr_decoder_decode:
+ * @request: what to decode
+ * @error: return location for an error
+ * @returns: the decoded image, or %NULL
+ *
+ * Decodes @request with the first capable backend that takes the
+ * file, going by its MIME type. Without data in @request, only region
+ * decoders are tried, and %NULL without an error means that none of
+ * them takes the file; the caller then reads it and tries again with
+ * the data. With data, gdk-pixbuf is the last resort. The outcome is
+ * filled into @request.
+ **/
+GdkPixbufAnimation *
+vnr_decoder_decode (VnrDecodeRequest *request, GError **error)
+{
+    gboolean region = request->data == NULL;
+    gchar *mime_type = NULL;
+    GdkPixbufAnimation *anim = NULL;
+    GError *local_error = NULL;
+    guint i;
+
+    request->format = NULL;
+    request->full_width = request->full_height = 0;
+    request->tiled = NULL;
+
+    for (i = 0; i < G_N_ELEMENTS (vnr_decoders); i++)
+    {
+        const VnrDecoder *decoder = vnr_decoders[i];
+        VnrDecodeRequest attempt;
+
+        if (((decoder->flags & VNR_DECODER_REGION) != 0) != region)
+            continue;
+
+        if (decoder->mime_types != NULL && mime_type == NULL)
+            mime_type = vnr_decoder_guess_mime_type (request);
+        if (!vnr_decoder_handles (decoder, mime_type))
+            continue;
+
+        /* Hide what the backend can't make use of */
+        attempt = *request;
+        if (!(decoder->flags & VNR_DECODER_SCALED))
+            attempt.max_width = attempt.max_height = 0;
+        if (!(decoder->flags & VNR_DECODER_STREAMING))
+            attempt.progress = NULL;
+
+        anim = decoder->decode (&attempt, &local_error);
+
+        if (anim != NULL)
+        {
+            request->format = attempt.format;
+            request->full_width = attempt.full_width;
+            request->full_height = attempt.full_height;
+            request->tiled = attempt.tiled;
+            break;
+        }
+
+        if (local_error != NULL)
+        {
+            g_propagate_error (error, local_error);
+            break;
+        }
+    }
+
+    g_free (mime_type);
+    return anim;
+}
+
+/**
+ * vnr_decoder_get_mime_types:
+ * @returns: a newly allocated list of the MIME types that can be
+ *   decoded. Free with g_list_free_full() and g_free().
+ **/
+GList *
+vnr_decoder_get_mime_types (void)
+{
+    GList *types = NULL;
+    GSList *formats, *it;
+    guint i, j;
+
+    for (i = 0; i < G_N_ELEMENTS (vnr_decoders); i++)
+    {
+        const gchar * const *mime_types = vnr_decoders[i]->mime_types;
+
+        for (j = 0; mime_types != NULL && mime_types[j] != NULL; j++)
+            if (!g_list_find_custom (types, mime_types[j], (GCompareFunc) strcmp))
+                types = g_list_prepend (types, g_strdup (mime_types[j]));
+    }
+
+    /* What gdk-pixbuf takes, as the last resort */
+    formats = gdk_pixbuf_get_formats ();
+    for (it = formats; it != NULL; it = it->next)
+    {
+        gchar **mime_types = gdk_pixbuf_format_get_mime_types (it->data);
+
+        for (j = 0; mime_types[j] != NULL; j++)
+            if (!g_list_find_custom (types, mime_types[j], (GCompareFunc) strcmp))
+                types = g_list_prepend (types, g_strdup (mime_types[j]));
+
+        g_strfreev (mime_types);
+    }
+    g_slist_free (formats);
+
+    return types;
+}
+
+/**
+ * vnr_decoder_find_format:
+ * @name: name of a gdk-pixbuf format, such as "jpeg"
+ * @returns: the format, or %NULL if gdk-pixbuf has no loader for it
+ *
+ * For backends that decode formats gdk-pixbuf knows as well, so that
+ * the image can still be saved through gdk-pixbuf.
+ **/
+GdkPixbufFormat *
+vnr_decoder_find_format (const gchar *name)
+{
+    GSList *formats = gdk_pixbuf_get_formats ();
+    GSList *it;
+    GdkPixbufFormat *format = NULL;
+
+    for (it = formats; it != NULL && format == NULL; it = it->next)
+    {
+        gchar *format_name = gdk_pixbuf_format_get_name (it->data);
+
+        if (g_strcmp0 (format_name, name) == 0)
+            format = it->data;
+        g_free (format_name);
+    }
+
+    g_slist_free (formats);
+    return format;
+}
+
+/**
+ * vnr_decoder_post_progress:
+ * @request: the request being decoded
+ * @pixbuf: the pixbuf being decoded into
+ * @area: the part of @pixbuf decoded since the last call
+ *
+ * Passes partial results on to the progress function of @request.
+ * Rotated images would turn around once fully decoded, so they are
+ * only shown when complete instead.
+ **/
+void
+vnr_decoder_post_progress (VnrDecodeRequest *request,
+                           GdkPixbuf *pixbuf, GdkRectangle *area)
+{
+    const gchar *orientation = gdk_pixbuf_get_option (pixbuf, "orientation");
+
+    if (request->progress == NULL
+        || (orientation != NULL && g_strcmp0 (orientation, "1") != 0))
+        return;
+
+    request->progress (pixbuf, area, request->progress_data);
+}
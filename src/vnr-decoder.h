@@ -0,0 +1,125 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __VNR_DECODER_H__
+#define __VNR_DECODER_H__
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <gdk/gdk.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include "uni-tiled-source.h"
+
+G_BEGIN_DECLS
+
+/**
+ * VnrDecoderFlags:
+ * @VNR_DECODER_SCALED: Decodes at a reduced size when the image is
+ *   fitted in a smaller area.
+ * @VNR_DECODER_REGION: Reads parts of the image from the file on
+ *   demand, through a #UniTiledSource. Tried before the file is read,
+ *   so it gets no data.
+ * @VNR_DECODER_STREAMING: Reports rows as they are decoded.
+ * @VNR_DECODER_THREADED: Spreads one decode over threads of its own.
+ *
+ * What a decoder is capable of. Decoders only get the parts of a
+ * #VnrDecodeRequest their flags say they make use of.
+ **/
+typedef enum {
+    VNR_DECODER_SCALED    = 1 << 0,
+    VNR_DECODER_REGION    = 1 << 1,
+    VNR_DECODER_STREAMING = 1 << 2,
+    VNR_DECODER_THREADED  = 1 << 3,
+} VnrDecoderFlags;
+
+/**
+ * VnrDecoderProgressFunc:
+ * @pixbuf: the pixbuf being decoded into
+ * @area: the part of @pixbuf decoded since the last call
+ * @user_data: the progress data of the request
+ *
+ * Called from the decoding thread as the image comes in.
+ **/
+typedef void (*VnrDecoderProgressFunc) (GdkPixbuf *pixbuf,
+                                        GdkRectangle *area,
+                                        gpointer user_data);
+
+typedef struct _VnrDecodeRequest VnrDecodeRequest;
+typedef struct _VnrDecoder VnrDecoder;
+
+struct _VnrDecodeRequest {
+    const gchar *path;
+
+    /* The contents of the file, or %NULL to try region decoders only */
+    GBytes *data;
+
+    /* Size the image is going to be shown at, or 0 for full size */
+    gint max_width;
+    gint max_height;
+
+    GCancellable *cancellable;
+
+    /* Where partial results go, or %NULL */
+    VnrDecoderProgressFunc progress;
+    gpointer progress_data;
+
+    /* Filled in by the decoder: the gdk-pixbuf format of the file if
+     * there is one, the size of the image in the file if it was
+     * decoded at a reduced size, and the full resolution for region
+     * decoders. */
+    GdkPixbufFormat *format;
+    gint full_width;
+    gint full_height;
+    UniTiledSource *tiled;
+};
+
+/**
+ * VnrDecoder:
+ * @name: name of the backend, for debugging
+ * @mime_types: %NULL-terminated MIME types the backend handles, or
+ *   %NULL to take any file
+ * @flags: what the backend is capable of
+ * @decode: decodes @request. Returns %NULL and sets the error if the
+ *   file is broken, or returns %NULL without an error to pass the
+ *   file on to the next backend.
+ *
+ * A decoding backend. Runs in worker threads, so nothing in there may
+ * touch GTK+.
+ **/
+struct _VnrDecoder {
+    const gchar *name;
+    const gchar * const *mime_types;
+    VnrDecoderFlags flags;
+    GdkPixbufAnimation* (*decode) (VnrDecodeRequest *request, GError **error);
+};
+
+GdkPixbufAnimation* vnr_decoder_decode  (VnrDecodeRequest *request,
+                                         GError **error);
+
+GList*      vnr_decoder_get_mime_types  (void);
+
+/* For backends */
+GdkPixbufFormat*    vnr_decoder_find_format     (const gchar *name);
+void                vnr_decoder_post_progress   (VnrDecodeRequest *request,
+                                                 GdkPixbuf *pixbuf,
+                                                 GdkRectangle *area);
+
+G_END_DECLS
+#endif /* __VNR_DECODER_H__ */
@@ -0,0 +1,433 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include "vnr-disk-cache.h"
+#include "vnr-tools.h"
+#include "uni-utils.h"
+
+/* Decoded images are kept under $XDG_CACHE_HOME/viewnior/pixels, one
+ * file per image, named after the SHA-1 of its path. A file holds a
+ * header and the pixels exactly as they are laid out in a GdkPixbuf,
+ * so that a hit maps the file and hands the pixels to a pixbuf without
+ * decoding or copying anything.
+ *
+ * Files are only ever written under a temporary name and renamed into
+ * place, never truncated, so a file that is still mapped by an image on
+ * screen stays intact when it is replaced or pruned. The modification
+ * time of a file is bumped on every hit; pruning removes the files that
+ * were used the longest time ago. */
+
+#define VNR_DISK_CACHE_MAGIC "VNRPIX01"
+
+/* Offset of the pixels in a cache file */
+#define VNR_DISK_CACHE_DATA_OFFSET 128
+
+typedef struct {
+    gchar magic[8];
+
+    guint32 width;
+    guint32 height;
+    guint32 rowstride;
+    guint32 has_alpha;
+
+    /* Size of the image in the file, and whether the pixels are
+     * reduced from it */
+    guint32 full_width;
+    guint32 full_height;
+    guint32 reduced;
+
+    /* EXIF orientation to show the pixels in; 0 is read as 1 */
+    guint32 orientation;
+
+    /* Stamp of the file the pixels were decoded from */
+    gint64 mtime;
+    gint64 file_size;
+
+    gchar format[32];
+} VnrDiskCacheHeader;
+
+G_STATIC_ASSERT (sizeof (VnrDiskCacheHeader) <= VNR_DISK_CACHE_DATA_OFFSET);
+
+G_LOCK_DEFINE_STATIC (vnr_disk_cache);
+static gsize vnr_disk_cache_limit = 0;
+
+/*************************************************************/
+/***** Private actions ***************************************/
+/*************************************************************/
+
+static gchar *
+vnr_disk_cache_get_dir (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "viewnior", "pixels", NULL);
+}
+
+static gchar *
+vnr_disk_cache_get_filename (const gchar *path)
+{
+    gchar *dir = vnr_disk_cache_get_dir ();
+    gchar *hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1, path, -1);
+    gchar *filename = g_build_filename (dir, hash, NULL);
+
+    g_free (hash);
+    g_free (dir);
+    return filename;
+}
+
+static gsize
+vnr_disk_cache_get_limit (void)
+{
+    gsize limit;
+
+    G_LOCK (vnr_disk_cache);
+    limit = vnr_disk_cache_limit;
+    G_UNLOCK (vnr_disk_cache);
+
+    return limit;
+}
+
+static gboolean
+vnr_disk_cache_write_all (int fd, const guchar *buf, gsize length)
+{
+    while (length > 0)
+    {
+        gssize written = write (fd, buf, length);
+
+        if (written < 0)
+            return FALSE;
+        buf += written;
+        length -= written;
+    }
+
+    return TRUE;
+}
+
+typedef struct {
+    gchar *name;
+    gint64 mtime;
+    goffset size;
+} VnrDiskCacheFile;
+
+static gint
+vnr_disk_cache_file_compare (gconstpointer a, gconstpointer b)
+{
+    gint64 ta = ((const VnrDiskCacheFile *) a)->mtime;
+    gint64 tb = ((const VnrDiskCacheFile *) b)->mtime;
+
+    return ta < tb ? -1 : ta > tb;
+}
+
+/* Removes the least recently used files until the cache fits in
+ * @limit. Also cleans up temporary files left behind by a crash. */
+static void
+vnr_disk_cache_prune (const gchar *dir, gsize limit)
+{
+    GDir *gdir = g_dir_open (dir, 0, NULL);
+    GSList *files = NULL, *item;
+    const gchar *name;
+    guint64 total = 0;
+    gint64 now = g_get_real_time ();
+
+    if (gdir == NULL)
+        return;
+
+    while ((name = g_dir_read_name (gdir)) != NULL)
+    {
+        gchar *filename = g_build_filename (dir, name, NULL);
+        GStatBuf st;
+        VnrDiskCacheFile *file;
+
+        if (g_stat (filename, &st) != 0)
+        {
+            g_free (filename);
+            continue;
+        }
+
+        if (g_str_has_suffix (name, ".tmp"))
+        {
+            if (now / G_USEC_PER_SEC - st.st_mtime > 60 * 60)
+                g_unlink (filename);
+            g_free (filename);
+            continue;
+        }
+
+        file = g_slice_new (VnrDiskCacheFile);
+        file->name = filename;
+        file->mtime = st.st_mtime;
+        file->size = st.st_size;
+        files = g_slist_prepend (files, file);
+        total += st.st_size;
+    }
+    g_dir_close (gdir);
+
+    files = g_slist_sort (files, vnr_disk_cache_file_compare);
+
+    for (item = files; item != NULL; item = item->next)
+    {
+        VnrDiskCacheFile *file = item->data;
+
+        if (total > limit && g_unlink (file->name) == 0)
+            total -= file->size;
+
+        g_free (file->name);
+        g_slice_free (VnrDiskCacheFile, file);
+    }
+
+    g_slist_free (files);
+}
+
+static void
+vnr_disk_cache_store_thread (GTask *task,
+                             gpointer source_object,
+                             gpointer task_data,
+                             GCancellable *cancellable)
+{
+    VnrImage *image = task_data;
+    GdkPixbuf *pixbuf = gdk_pixbuf_animation_get_static_image (image->anim);
+    VnrDiskCacheHeader header;
+    guchar padding[VNR_DISK_CACHE_DATA_OFFSET];
+    gsize limit = vnr_disk_cache_get_limit ();
+    gchar *dir, *filename, *tmp;
+    int fd;
+
+    if (limit == 0)
+        return;
+
+    memset (&header, 0, sizeof header);
+    memcpy (header.magic, VNR_DISK_CACHE_MAGIC, sizeof header.magic);
+    header.width = gdk_pixbuf_get_width (pixbuf);
+    header.height = gdk_pixbuf_get_height (pixbuf);
+    header.rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+    header.has_alpha = gdk_pixbuf_get_has_alpha (pixbuf);
+    header.full_width = image->width;
+    header.full_height = image->height;
+    header.reduced = image->reduced;
+    header.orientation = image->orientation;
+    header.mtime = image->mtime;
+    header.file_size = image->file_size;
+    if (image->writable_format_name)
+        g_strlcpy (header.format, image->writable_format_name, sizeof header.format);
+
+    memset (padding, 0, sizeof padding);
+    memcpy (padding, &header, sizeof header);
+
+    dir = vnr_disk_cache_get_dir ();
+    if (g_mkdir_with_parents (dir, 0700) != 0)
+    {
+        g_free (dir);
+        return;
+    }
+
+    filename = vnr_disk_cache_get_filename (image->path);
+    tmp = g_strconcat (filename, "-XXXXXX.tmp", NULL);
+
+    fd = g_mkstemp_full (tmp, O_RDWR, 0600);
+    if (fd >= 0)
+    {
+        gboolean ok;
+
+        ok = vnr_disk_cache_write_all (fd, padding, sizeof padding)
+             && vnr_disk_cache_write_all (fd, gdk_pixbuf_get_pixels (pixbuf),
+                                          gdk_pixbuf_get_byte_length (pixbuf));
+        ok = close (fd) == 0 && ok;
+
+        if (!ok || g_rename (tmp, filename) != 0)
+            g_unlink (tmp);
+    }
+
+    G_LOCK (vnr_disk_cache);
+    vnr_disk_cache_prune (dir, vnr_disk_cache_limit);
+    G_UNLOCK (vnr_disk_cache);
+
+    g_free (tmp);
+    g_free (filename);
+    g_free (dir);
+}
+
+/*************************************************************/
+/***** Actions ***********************************************/
+/*************************************************************/
+
+/**
+ * vnr_disk_cache_set_limit:
+ * @limit: the most bytes the cache may take on disk, or 0 to disable it
+ **/
+void
+vnr_disk_cache_set_limit (gsize limit)
+{
+    G_LOCK (vnr_disk_cache);
+    vnr_disk_cache_limit = limit;
+    G_UNLOCK (vnr_disk_cache);
+}
+
+gboolean
+vnr_disk_cache_is_enabled (void)
+{
+    return vnr_disk_cache_get_limit () > 0;
+}
+
+/**
+ * vnr_disk_cache_lookup:
+ * @path: the file to look for
+ * @mtime: modification time of @path, as in #VnrImage
+ * @file_size: size of @path
+ * @max_width: width of the area the image is going to be fitted in,
+ *   or 0 if it is needed at full size
+ * @max_height: height of that area, or 0
+ * @returns: a new image backed by the cache file, or %NULL if there is
+ *   none that is current and large enough.
+ *
+ * May be called from any thread. The returned image has no file
+ * contents attached.
+ **/
+VnrImage *
+vnr_disk_cache_lookup (const gchar *path,
+                       gint64 mtime,
+                       goffset file_size,
+                       gint max_width,
+                       gint max_height)
+{
+    VnrDiskCacheHeader header;
+    GMappedFile *mapped;
+    GdkPixbuf *pixbuf;
+    GdkPixbufSimpleAnim *anim;
+    VnrImage *image;
+    gchar *filename;
+    gsize length, needed;
+    guint n_channels;
+
+    if (!vnr_disk_cache_is_enabled ())
+        return NULL;
+
+    filename = vnr_disk_cache_get_filename (path);
+
+    /* Mapped privately and writable, so that nobody modifying the
+     * pixels in place could ever reach the file */
+    mapped = g_mapped_file_new (filename, TRUE, NULL);
+    if (mapped == NULL)
+    {
+        g_free (filename);
+        return NULL;
+    }
+
+    length = g_mapped_file_get_length (mapped);
+    if (length < VNR_DISK_CACHE_DATA_OFFSET)
+        goto miss;
+
+    memcpy (&header, g_mapped_file_get_contents (mapped), sizeof header);
+    header.format[sizeof header.format - 1] = '\0';
+
+    n_channels = header.has_alpha ? 4 : 3;
+    needed = (gsize) header.rowstride * (header.height - 1)
+             + (gsize) header.width * n_channels;
+
+    if (memcmp (header.magic, VNR_DISK_CACHE_MAGIC, sizeof header.magic) != 0
+        || header.mtime != mtime || header.file_size != file_size
+        || header.width == 0 || header.height == 0
+        || header.width > G_MAXINT / 4 || header.height > G_MAXINT
+        || header.rowstride < header.width * n_channels
+        || length - VNR_DISK_CACHE_DATA_OFFSET < needed)
+        goto miss;
+
+    /* Decoded for a smaller view than the one asked for now */
+    if (header.reduced)
+    {
+        gint width = header.full_width, height = header.full_height;
+
+        if (max_width <= 0 || max_height <= 0)
+            goto miss;
+
+        vnr_tools_fit_to_size (&width, &height, max_width, max_height);
+        if (UNI_ORIENTATION_IS_TRANSPOSED (header.orientation))
+        {
+            gint tmp = width;
+            width = height;
+            height = tmp;
+        }
+        if ((gint) header.width < width || (gint) header.height < height)
+            goto miss;
+    }
+
+    pixbuf = gdk_pixbuf_new_from_data ((guchar *) g_mapped_file_get_contents (mapped)
+                                       + VNR_DISK_CACHE_DATA_OFFSET,
+                                       GDK_COLORSPACE_RGB, header.has_alpha, 8,
+                                       header.width, header.height,
+                                       header.rowstride,
+                                       (GdkPixbufDestroyNotify) g_mapped_file_unref,
+                                       mapped);
+
+    anim = gdk_pixbuf_simple_anim_new (header.width, header.height, 1);
+    gdk_pixbuf_simple_anim_add_frame (anim, pixbuf);
+    g_object_unref (pixbuf);
+
+    image = vnr_image_new ();
+    image->path = g_strdup (path);
+    image->anim = GDK_PIXBUF_ANIMATION (anim);
+    image->mtime = mtime;
+    image->file_size = file_size;
+    image->width = header.full_width;
+    image->height = header.full_height;
+    image->reduced = header.reduced;
+    if (header.orientation >= 1 && header.orientation <= 8)
+        image->orientation = header.orientation;
+    if (header.format[0] != '\0')
+        image->writable_format_name = g_strdup (header.format);
+
+    /* Mark the file as recently used */
+    g_utime (filename, NULL);
+    g_free (filename);
+
+    return image;
+
+miss:
+    g_mapped_file_unref (mapped);
+    g_free (filename);
+    return NULL;
+}
+
+/**
+ * vnr_disk_cache_store_async:
+ * @image: a freshly decoded image
+ *
+ * Writes the pixels of @image to the cache in the background, then
+ * prunes the cache down to its limit. Animations and tiled images are
+ * not cached. May be called from any thread.
+ **/
+void
+vnr_disk_cache_store_async (VnrImage *image)
+{
+    GTask *task;
+
+    if (!vnr_disk_cache_is_enabled () || image->tiled != NULL
+        || !gdk_pixbuf_animation_is_static_image (image->anim))
+        return;
+
+    task = g_task_new (NULL, NULL, NULL, NULL);
+    g_task_set_task_data (task, vnr_image_ref (image),
+                          (GDestroyNotify) vnr_image_unref);
+    g_task_run_in_thread (task, vnr_disk_cache_store_thread);
+    g_object_unref (task);
+}
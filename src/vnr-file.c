@@ -26,6 +26,7 @@
 #include <gdk/gdkpixbuf.h>
 #include "vnr-file.h"
 #include "vnr-tools.h"
+#include "vnr-decoder.h"
 
 G_DEFINE_TYPE (VnrFile, vnr_file, G_TYPE_OBJECT);
 
@@ -40,37 +41,19 @@ compare_files(VnrFile *file, char *uri)
         return 1;
 }
 
-/* Modified version of eog's eog_image_get_supported_mime_types */
+/* Modified version of eog's eog_image_get_supported_mime_types.
+ * Whatever one of the decoders takes is supported. */
 static GList *
 vnr_file_get_supported_mime_types (void)
 {
-    GSList *format_list, *it;
-    gchar **mime_types;
-    int i;
-
     if (!supported_mime_types) {
-        format_list = gdk_pixbuf_get_formats ();
-
-        for (it = format_list; it != NULL; it = it->next) {
-            mime_types =
-                gdk_pixbuf_format_get_mime_types ((GdkPixbufFormat *) it->data);
-
-            for (i = 0; mime_types[i] != NULL; i++) {
-                supported_mime_types =
-                    g_list_prepend (supported_mime_types,
-                            g_strdup (mime_types[i]));
-            }
-
-            g_strfreev (mime_types);
-        }
+        supported_mime_types = vnr_decoder_get_mime_types ();
 
         supported_mime_types = g_list_prepend(supported_mime_types,
                                               "image/vnd.microsoft.icon");
 
         supported_mime_types = g_list_sort (supported_mime_types,
                             (GCompareFunc) compare_quarks);
-
-        g_slist_free (format_list);
     }
 
     return supported_mime_types;
@@ -0,0 +1,195 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <glib.h>
+#include "vnr-image-cache.h"
+
+/*************************************************************/
+/***** Private actions ***************************************/
+/*************************************************************/
+
+static void
+vnr_image_cache_remove_link (VnrImageCache *cache, GList *link)
+{
+    VnrImage *image = link->data;
+
+    g_hash_table_remove (cache->entries, image->path);
+    cache->used -= vnr_image_size (image);
+    g_queue_delete_link (cache->lru, link);
+    vnr_image_unref (image);
+}
+
+static void
+vnr_image_cache_trim (VnrImageCache *cache)
+{
+    while (cache->used > cache->budget && !g_queue_is_empty (cache->lru))
+        vnr_image_cache_remove_link (cache, g_queue_peek_tail_link (cache->lru));
+}
+
+/*************************************************************/
+/***** Actions ***********************************************/
+/*************************************************************/
+
+VnrImageCache *
+vnr_image_cache_new (void)
+{
+    VnrImageCache *cache = g_slice_new0 (VnrImageCache);
+
+    cache->entries = g_hash_table_new (g_str_hash, g_str_equal);
+    cache->lru = g_queue_new ();
+    cache->budget = 128 * 1024 * 1024;
+
+    return cache;
+}
+
+void
+vnr_image_cache_free (VnrImageCache *cache)
+{
+    if (cache == NULL)
+        return;
+
+    g_debug ("Image cache: %u hits, %u misses", cache->hits, cache->misses);
+
+    g_hash_table_destroy (cache->entries);
+    g_queue_free_full (cache->lru, (GDestroyNotify) vnr_image_unref);
+    g_slice_free (VnrImageCache, cache);
+}
+
+/**
+ * vnr_image_cache_set_budget:
+ * @budget: the most bytes the cached images may take, or 0 to disable
+ *   the cache
+ **/
+void
+vnr_image_cache_set_budget (VnrImageCache *cache, gsize budget)
+{
+    cache->budget = budget;
+    vnr_image_cache_trim (cache);
+}
+
+/* The link of the cached image of @path, if it will do */
+static GList *
+vnr_image_cache_find (VnrImageCache *cache, const gchar *path, gboolean full_size)
+{
+    GList *link = g_hash_table_lookup (cache->entries, path);
+
+    if (link == NULL)
+        return NULL;
+
+    if (full_size && ((VnrImage *) link->data)->reduced)
+        return NULL;
+
+    return link;
+}
+
+/**
+ * vnr_image_cache_lookup:
+ * @path: the file to look for
+ * @full_size: whether an image decoded at a reduced size won't do
+ * @returns: a new reference to the cached image of @path, or %NULL if
+ *   there is none.
+ *
+ * The file is not looked at, so the image may be stale; check it with
+ * vnr_image_check_async() before showing it.
+ **/
+VnrImage *
+vnr_image_cache_lookup (VnrImageCache *cache, const gchar *path, gboolean full_size)
+{
+    GList *link = vnr_image_cache_find (cache, path, full_size);
+
+    if (link == NULL)
+    {
+        cache->misses++;
+        return NULL;
+    }
+
+    g_queue_unlink (cache->lru, link);
+    g_queue_push_head_link (cache->lru, link);
+
+    cache->hits++;
+    return vnr_image_ref (link->data);
+}
+
+/**
+ * vnr_image_cache_contains:
+ * @path: the file to look for
+ * @full_size: whether an image decoded at a reduced size won't do
+ * @returns: whether vnr_image_cache_lookup() would find an image.
+ *
+ * Unlike a lookup, this neither counts as a hit or miss nor makes the
+ * image recently used.
+ **/
+gboolean
+vnr_image_cache_contains (VnrImageCache *cache, const gchar *path, gboolean full_size)
+{
+    return vnr_image_cache_find (cache, path, full_size) != NULL;
+}
+
+/**
+ * vnr_image_cache_insert:
+ * @image: a freshly decoded image
+ *
+ * Adds @image to the cache, replacing whatever was cached for the same
+ * path. A reduced image does not replace a full size one of the same
+ * file, as the full size one serves every view.
+ **/
+void
+vnr_image_cache_insert (VnrImageCache *cache, VnrImage *image)
+{
+    GList *link = g_hash_table_lookup (cache->entries, image->path);
+    gsize size = vnr_image_size (image);
+
+    if (link != NULL)
+    {
+        VnrImage *old = link->data;
+
+        if (old == image)
+            return;
+        if (image->reduced && !old->reduced
+            && old->mtime == image->mtime && old->file_size == image->file_size)
+            return;
+        vnr_image_cache_remove_link (cache, link);
+    }
+
+    /* Wouldn't fit even in an empty cache */
+    if (size > cache->budget)
+        return;
+
+    g_queue_push_head (cache->lru, vnr_image_ref (image));
+    g_hash_table_insert (cache->entries, image->path, cache->lru->head);
+    cache->used += size;
+
+    vnr_image_cache_trim (cache);
+}
+
+/**
+ * vnr_image_cache_invalidate:
+ * @path: a file that was changed or deleted
+ *
+ * Drops the cached image of @path, if any.
+ **/
+void
+vnr_image_cache_invalidate (VnrImageCache *cache, const gchar *path)
+{
+    GList *link = g_hash_table_lookup (cache->entries, path);
+
+    if (link != NULL)
+        vnr_image_cache_remove_link (cache, link);
+}
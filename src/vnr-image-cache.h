@@ -0,0 +1,78 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VNR_IMAGE_CACHE_H__
+#define __VNR_IMAGE_CACHE_H__
+
+#include <glib.h>
+#include "vnr-loader.h"
+
+G_BEGIN_DECLS
+
+typedef struct _VnrImageCache VnrImageCache;
+
+/**
+ * VnrImageCache:
+ *
+ * Keeps recently shown images decoded, so that going back to one of
+ * them, or reloading a file that did not change, doesn't decode it
+ * again. Images are looked up by path. Lookups don't touch the disk;
+ * whether the file still has the modification time and size an image
+ * was decoded from is up to the caller to check, off the main thread,
+ * with vnr_image_check_async(). The least recently used images are
+ * dropped once the decoded images take more than the budget.
+ *
+ * All functions must be called from the main thread.
+ **/
+struct _VnrImageCache {
+    /* Path -> GList link in @lru */
+    GHashTable *entries;
+
+    /* VnrImages, most recently used first */
+    GQueue *lru;
+
+    gsize used;
+    gsize budget;
+
+    guint hits;
+    guint misses;
+};
+
+VnrImageCache*  vnr_image_cache_new         (void);
+void            vnr_image_cache_free        (VnrImageCache *cache);
+
+void            vnr_image_cache_set_budget  (VnrImageCache *cache,
+                                             gsize budget);
+
+VnrImage*       vnr_image_cache_lookup      (VnrImageCache *cache,
+                                             const gchar *path,
+                                             gboolean full_size);
+
+gboolean        vnr_image_cache_contains    (VnrImageCache *cache,
+                                             const gchar *path,
+                                             gboolean full_size);
+
+void            vnr_image_cache_insert      (VnrImageCache *cache,
+                                             VnrImage *image);
+
+void            vnr_image_cache_invalidate  (VnrImageCache *cache,
+                                             const gchar *path);
+
+G_END_DECLS
+#endif /* __VNR_IMAGE_CACHE_H__ */
@@ -0,0 +1,304 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "config.h"
+
+#ifdef HAVE_LIBJPEG
+
+#include <stdio.h>
+#include <string.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+#include "vnr-jpeg.h"
+#include "vnr-tools.h"
+#include "uni-utils.h"
+
+/* Rows are decoded, and handed to the rows function, in bands of this
+ * height */
+#define VNR_JPEG_BAND_ROWS 64
+
+/* EXIF tag holding the orientation */
+#define VNR_JPEG_TAG_ORIENTATION 0x0112
+
+typedef struct {
+    struct jpeg_error_mgr pub;
+    jmp_buf setjmp_buffer;
+} VnrJpegError;
+
+/*************************************************************/
+/***** Private actions ***************************************/
+/*************************************************************/
+
+static void
+vnr_jpeg_error_exit (j_common_ptr cinfo)
+{
+    VnrJpegError *error = (VnrJpegError *) cinfo->err;
+
+    longjmp (error->setjmp_buffer, 1);
+}
+
+/* Warnings are about damaged data, which gets decoded as well as it
+ * can be. gdk-pixbuf keeps quiet about them too. */
+static void
+vnr_jpeg_output_message (j_common_ptr cinfo)
+{
+}
+
+static guint
+vnr_jpeg_get_uint16 (const guchar *p, gboolean big_endian)
+{
+    if (big_endian)
+        return (p[0] << 8) | p[1];
+    return (p[1] << 8) | p[0];
+}
+
+static guint32
+vnr_jpeg_get_uint32 (const guchar *p, gboolean big_endian)
+{
+    if (big_endian)
+        return ((guint32) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    return ((guint32) p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+}
+
+/* Finds the orientation tag in the first IFD of the EXIF block, which
+ * is as far as gdk-pixbuf's own loader looks as well. */
+static gint
+vnr_jpeg_get_orientation (j_decompress_ptr cinfo)
+{
+    jpeg_saved_marker_ptr marker;
+
+    for (marker = cinfo->marker_list; marker != NULL; marker = marker->next)
+    {
+        const guchar *tiff = marker->data + 6;
+        guint32 length, ifd, i, n_entries;
+        gboolean big_endian;
+
+        if (marker->marker != JPEG_APP0 + 1 || marker->data_length < 14
+            || memcmp (marker->data, "Exif\0\0", 6) != 0)
+            continue;
+
+        length = marker->data_length - 6;
+
+        if (tiff[0] == 'M' && tiff[1] == 'M')
+            big_endian = TRUE;
+        else if (tiff[0] == 'I' && tiff[1] == 'I')
+            big_endian = FALSE;
+        else
+            continue;
+
+        ifd = vnr_jpeg_get_uint32 (tiff + 4, big_endian);
+        if (ifd < 8 || ifd > length - 2)
+            continue;
+
+        n_entries = vnr_jpeg_get_uint16 (tiff + ifd, big_endian);
+        for (i = 0; i < n_entries && ifd + 2 + (i + 1) * 12 <= length; i++)
+        {
+            const guchar *entry = tiff + ifd + 2 + i * 12;
+            guint value;
+
+            if (vnr_jpeg_get_uint16 (entry, big_endian) != VNR_JPEG_TAG_ORIENTATION)
+                continue;
+
+            value = vnr_jpeg_get_uint16 (entry + 8, big_endian);
+            return value >= 1 && value <= 8 ? value : 1;
+        }
+    }
+
+    return 1;
+}
+
+/* Picks the largest reduction the decoder can do in the DCT domain
+ * that still covers the size the image is going to be fitted at. */
+static void
+vnr_jpeg_set_scale (j_decompress_ptr cinfo, gint orientation,
+                    gint max_width, gint max_height)
+{
+    gint width = cinfo->image_width;
+    gint height = cinfo->image_height;
+    guint denom;
+
+    cinfo->scale_num = 1;
+    cinfo->scale_denom = 1;
+
+    if (max_width <= 0 || max_height <= 0)
+        return;
+
+    /* Fitting the turned image is fitting the stored one in the turned
+     * area */
+    if (UNI_ORIENTATION_IS_TRANSPOSED (orientation))
+        vnr_tools_fit_to_size (&width, &height, max_height, max_width);
+    else
+        vnr_tools_fit_to_size (&width, &height, max_width, max_height);
+
+    for (denom = 8; denom > 1; denom /= 2)
+    {
+        if ((cinfo->image_width + denom - 1) / denom >= (guint) width
+            && (cinfo->image_height + denom - 1) / denom >= (guint) height)
+        {
+            cinfo->scale_denom = denom;
+            return;
+        }
+    }
+}
+
+static gboolean
+vnr_jpeg_is_jpeg (const guchar *data, gsize length)
+{
+    return length >= 3 && data[0] == 0xff && data[1] == 0xd8 && data[2] == 0xff;
+}
+
+/* Decodes with libjpeg straight into a pixbuf. When fitting the image,
+ * the decoder drops the detail that won't be shown by scaling by 1/2,
+ * 1/4 or 1/8 in the DCT domain, which is a lot faster than decoding
+ * everything and scaling down afterwards. The result is never smaller
+ * than the fitted size.
+ *
+ * Like gdk-pixbuf, the EXIF orientation is stored as the "orientation"
+ * option of the pixbuf; the pixels are not turned.
+ *
+ * CMYK files and anything libjpeg fails on are passed on to gdk-pixbuf,
+ * which has its own ways with broken files. */
+static GdkPixbufAnimation *
+vnr_jpeg_decode (VnrDecodeRequest *request, GError **error)
+{
+    struct jpeg_decompress_struct cinfo;
+    VnrJpegError jerr;
+    GdkPixbuf *volatile pixbuf = NULL;
+    GdkPixbufSimpleAnim *anim;
+    JSAMPROW rows[VNR_JPEG_BAND_ROWS];
+    const guchar *data;
+    gsize length;
+    guchar *pixels;
+    gint rowstride, orientation;
+    gchar *value;
+
+    data = g_bytes_get_data (request->data, &length);
+    if (!vnr_jpeg_is_jpeg (data, length))
+        return NULL;
+
+    cinfo.err = jpeg_std_error (&jerr.pub);
+    jerr.pub.error_exit = vnr_jpeg_error_exit;
+    jerr.pub.output_message = vnr_jpeg_output_message;
+
+    if (setjmp (jerr.setjmp_buffer))
+    {
+        jpeg_destroy_decompress (&cinfo);
+        if (pixbuf != NULL)
+            g_object_unref (pixbuf);
+        return NULL;
+    }
+
+    jpeg_create_decompress (&cinfo);
+    jpeg_mem_src (&cinfo, (unsigned char *) data, length);
+    jpeg_save_markers (&cinfo, JPEG_APP0 + 1, 0xffff);
+    jpeg_read_header (&cinfo, TRUE);
+
+    /* CMYK files, mostly from Photoshop, store their inks inverted or
+     * not depending on the application; gdk-pixbuf knows the tricks. */
+    if (cinfo.jpeg_color_space != JCS_GRAYSCALE
+        && cinfo.jpeg_color_space != JCS_YCbCr
+        && cinfo.jpeg_color_space != JCS_RGB)
+    {
+        jpeg_destroy_decompress (&cinfo);
+        return NULL;
+    }
+
+    orientation = vnr_jpeg_get_orientation (&cinfo);
+
+    cinfo.out_color_space = JCS_RGB;
+    vnr_jpeg_set_scale (&cinfo, orientation,
+                        request->max_width, request->max_height);
+    jpeg_start_decompress (&cinfo);
+
+    pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8,
+                             cinfo.output_width, cinfo.output_height);
+    if (pixbuf == NULL)
+    {
+        jpeg_destroy_decompress (&cinfo);
+        return NULL;
+    }
+
+    value = g_strdup_printf ("%d", orientation);
+    gdk_pixbuf_set_option (pixbuf, "orientation", value);
+    g_free (value);
+
+    /* Rows still to come must not show whatever was in memory */
+    if (request->progress != NULL)
+        gdk_pixbuf_fill (pixbuf, 0x00000000);
+
+    pixels = gdk_pixbuf_get_pixels (pixbuf);
+    rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+
+    while (cinfo.output_scanline < cinfo.output_height)
+    {
+        guint start = cinfo.output_scanline;
+        guint n_rows = MIN (VNR_JPEG_BAND_ROWS, cinfo.output_height - start);
+        GdkRectangle area = { 0, start, cinfo.output_width, n_rows };
+        guint i;
+
+        for (i = 0; i < n_rows; i++)
+            rows[i] = pixels + (gsize) (start + i) * rowstride;
+
+        /* The decoder hands out a few rows per call at most */
+        while (cinfo.output_scanline < start + n_rows)
+            jpeg_read_scanlines (&cinfo, rows + (cinfo.output_scanline - start),
+                                 start + n_rows - cinfo.output_scanline);
+
+        vnr_decoder_post_progress (request, pixbuf, &area);
+
+        if (g_cancellable_set_error_if_cancelled (request->cancellable, error))
+        {
+            jpeg_destroy_decompress (&cinfo);
+            g_object_unref (pixbuf);
+            return NULL;
+        }
+    }
+
+    if (cinfo.output_width != cinfo.image_width)
+    {
+        request->full_width = cinfo.image_width;
+        request->full_height = cinfo.image_height;
+    }
+
+    jpeg_finish_decompress (&cinfo);
+    jpeg_destroy_decompress (&cinfo);
+
+    anim = gdk_pixbuf_simple_anim_new (gdk_pixbuf_get_width (pixbuf),
+                                       gdk_pixbuf_get_height (pixbuf), 1);
+    gdk_pixbuf_simple_anim_add_frame (anim, pixbuf);
+    g_object_unref (pixbuf);
+
+    request->format = vnr_decoder_find_format ("jpeg");
+    return GDK_PIXBUF_ANIMATION (anim);
+}
+
+static const gchar * const vnr_jpeg_mime_types[] = {
+    "image/jpeg",
+    NULL
+};
+
+const VnrDecoder vnr_jpeg_decoder = {
+    "libjpeg",
+    vnr_jpeg_mime_types,
+    VNR_DECODER_SCALED | VNR_DECODER_STREAMING,
+    vnr_jpeg_decode
+};
+
+#endif /* HAVE_LIBJPEG */
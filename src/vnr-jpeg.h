@@ -0,0 +1,32 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __VNR_JPEG_H__
+#define __VNR_JPEG_H__
+
+#include "vnr-decoder.h"
+
+G_BEGIN_DECLS
+
+/* Decodes JPEG files with libjpeg, reducing them in the DCT domain */
+extern const VnrDecoder vnr_jpeg_decoder;
+
+G_END_DECLS
+#endif /* __VNR_JPEG_H__ */
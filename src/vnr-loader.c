@@ -0,0 +1,604 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <libintl.h>
+#include <glib/gi18n.h>
+#define _(String) gettext (String)
+
+#include <stdlib.h>
+#include <glib.h>
+#include <gio/gio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gdk/gdk.h>
+#include "vnr-loader.h"
+#include "vnr-tools.h"
+#include "uni-utils.h"
+#include "uni-exiv2.hpp"
+#include "vnr-decoder.h"
+#include "vnr-disk-cache.h"
+
+/*************************************************************/
+/***** VnrImage **********************************************/
+/*************************************************************/
+
+VnrImage *
+vnr_image_new (void)
+{
+    VnrImage *image = g_slice_new0 (VnrImage);
+    image->ref_count = 1;
+    image->orientation = 1;
+    return image;
+}
+
+VnrImage *
+vnr_image_ref (VnrImage *image)
+{
+    g_return_val_if_fail (image != NULL, NULL);
+    g_atomic_int_inc (&image->ref_count);
+    return image;
+}
+
+void
+vnr_image_unref (VnrImage *image)
+{
+    g_return_if_fail (image != NULL);
+
+    if (!g_atomic_int_dec_and_test (&image->ref_count))
+        return;
+
+    if (image->anim)
+        g_object_unref (image->anim);
+    if (image->data)
+        g_bytes_unref (image->data);
+    if (image->tiled)
+        uni_tiled_source_unref (image->tiled);
+    g_free (image->writable_format_name);
+    g_free (image->path);
+    g_slice_free (VnrImage, image);
+}
+
+/**
+ * vnr_image_size:
+ * @image: a decoded image
+ * @returns: roughly how many bytes @image takes, file contents
+ *   included.
+ **/
+gsize
+vnr_image_size (VnrImage *image)
+{
+    gsize size = image->data ? g_bytes_get_size (image->data) : 0;
+
+    if (image->tiled)
+        size += image->tiled->budget;
+
+    if (gdk_pixbuf_animation_is_static_image (image->anim))
+    {
+        GdkPixbuf *pixbuf = gdk_pixbuf_animation_get_static_image (image->anim);
+
+        return size + (gsize) gdk_pixbuf_get_rowstride (pixbuf)
+                      * gdk_pixbuf_get_height (pixbuf);
+    }
+
+    /* Frames of animations are composed on demand, so count one RGBA
+     * frame as an estimate. */
+    return size + (gsize) image->width * image->height * 4;
+}
+
+static gboolean
+vnr_image_query_stamp (const gchar *path, gint64 *mtime, goffset *size)
+{
+    GFile *file = g_file_new_for_path (path);
+    GFileInfo *info;
+
+    info = g_file_query_info (file,
+                              G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                              G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC ","
+                              G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                              G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    g_object_unref (file);
+
+    if (info == NULL)
+        return FALSE;
+
+    *mtime = (gint64) g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED)
+             * G_USEC_PER_SEC
+             + g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+    *size = g_file_info_get_size (info);
+
+    g_object_unref (info);
+    return TRUE;
+}
+
+static void
+vnr_image_check_thread (GTask *task,
+                        gpointer source_object,
+                        gpointer task_data,
+                        GCancellable *cancellable)
+{
+    VnrImage *image = task_data;
+    gint64 mtime;
+    goffset size;
+
+    g_task_return_boolean (task,
+                           vnr_image_query_stamp (image->path, &mtime, &size)
+                           && mtime == image->mtime
+                           && size == image->file_size);
+}
+
+/**
+ * vnr_image_check_async:
+ * @image: a decoded image
+ * @cancellable: a #GCancellable or %NULL
+ * @callback: called in the main context once the file was looked at
+ * @user_data: data for @callback
+ *
+ * Finds out whether the file @image was decoded from is still the
+ * same on disk, going by its modification time and size. The file is
+ * looked at on a worker thread, as that can take long on network
+ * mounts.
+ **/
+void
+vnr_image_check_async (VnrImage *image,
+                       GCancellable *cancellable,
+                       GAsyncReadyCallback callback,
+                       gpointer user_data)
+{
+    GTask *task;
+
+    task = g_task_new (NULL, cancellable, callback, user_data);
+    g_task_set_source_tag (task, vnr_image_check_async);
+    g_task_set_task_data (task, vnr_image_ref (image),
+                          (GDestroyNotify) vnr_image_unref);
+    g_task_run_in_thread (task, vnr_image_check_thread);
+    g_object_unref (task);
+}
+
+/**
+ * vnr_image_check_finish:
+ * @result: the #GAsyncResult passed to the callback
+ * @error: return location for a #GError
+ * @returns: %TRUE if the file is unchanged, %FALSE if it changed, is
+ *   gone or the check was cancelled.
+ **/
+gboolean
+vnr_image_check_finish (GAsyncResult *result, GError **error)
+{
+    g_return_val_if_fail (g_task_is_valid (result, NULL), FALSE);
+
+    return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/*************************************************************/
+/***** Worker ************************************************/
+/*************************************************************/
+
+typedef struct {
+    gchar *path;
+
+    /* Size the image is going to be shown at, or 0 for full size */
+    gint max_width;
+    gint max_height;
+
+    VnrLoaderProgressFunc progress;
+    gpointer progress_data;
+    GDestroyNotify progress_destroy;
+} VnrLoaderJob;
+
+typedef struct {
+    GTask *task;
+    GdkPixbuf *pixbuf;
+    GdkRectangle area;
+} VnrLoaderProgress;
+
+static void
+vnr_loader_job_free (VnrLoaderJob *job)
+{
+    if (job->progress_destroy)
+        job->progress_destroy (job->progress_data);
+    g_free (job->path);
+    g_slice_free (VnrLoaderJob, job);
+}
+
+static void
+vnr_loader_progress_free (VnrLoaderProgress *progress)
+{
+    g_object_unref (progress->pixbuf);
+    g_object_unref (progress->task);
+    g_slice_free (VnrLoaderProgress, progress);
+}
+
+/* Runs in the main context */
+static gboolean
+vnr_loader_progress_dispatch (VnrLoaderProgress *progress)
+{
+    VnrLoaderJob *job = g_task_get_task_data (progress->task);
+    GCancellable *cancellable = g_task_get_cancellable (progress->task);
+
+    if (cancellable == NULL || !g_cancellable_is_cancelled (cancellable))
+        job->progress (progress->pixbuf,
+                       progress->area.x, progress->area.y,
+                       progress->area.width, progress->area.height,
+                       job->progress_data);
+
+    return FALSE;
+}
+
+/* Hands what was decoded since the last call to the main context */
+static void
+vnr_loader_post_progress (GdkPixbuf *pixbuf, GdkRectangle *area, gpointer user_data)
+{
+    GTask *task = user_data;
+    VnrLoaderProgress *progress;
+
+    progress = g_slice_new (VnrLoaderProgress);
+    progress->task = g_object_ref (task);
+    progress->pixbuf = g_object_ref (pixbuf);
+    progress->area = *area;
+
+    g_main_context_invoke_full (g_task_get_context (task),
+                                G_PRIORITY_DEFAULT,
+                                (GSourceFunc) vnr_loader_progress_dispatch,
+                                progress,
+                                (GDestroyNotify) vnr_loader_progress_free);
+}
+
+static GdkPixbuf *
+vnr_loader_decode_pixbuf (const guchar *buf, gsize length)
+{
+    GdkPixbufLoader *loader = gdk_pixbuf_loader_new ();
+    GdkPixbuf *pixbuf = NULL;
+
+    if (gdk_pixbuf_loader_write (loader, buf, length, NULL)
+        && gdk_pixbuf_loader_close (loader, NULL))
+    {
+        pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+        if (pixbuf != NULL)
+            g_object_ref (pixbuf);
+    }
+    else
+    {
+        gdk_pixbuf_loader_close (loader, NULL);
+    }
+
+    g_object_unref (loader);
+    return pixbuf;
+}
+
+/* Shows the preview embedded in the file, if it is good enough to
+ * stand in for the image while it is decoded. The preview is scaled to
+ * the size the image is going to be fitted at, so the view lays it out
+ * just like the decoded image. Returns whether a preview was posted. */
+static gboolean
+vnr_loader_show_preview (GTask *task, GBytes *data)
+{
+    VnrLoaderJob *job = g_task_get_task_data (task);
+    GdkPixbuf *preview, *scaled;
+    GdkRectangle area = { 0, 0, 0, 0 };
+    guchar *buf;
+    glong preview_size;
+    gsize length;
+    gint orientation, width, height;
+    gchar *value;
+
+    buf = uni_read_exiv2_preview (g_bytes_get_data (data, &length), (long) length,
+                                  &preview_size, &orientation, &width, &height);
+    if (buf == NULL)
+        return FALSE;
+
+    preview = vnr_loader_decode_pixbuf (buf, preview_size);
+    g_free (buf);
+
+    if (preview == NULL)
+        return FALSE;
+
+    /* Previews carry no orientation of their own */
+    value = g_strdup_printf ("%d", orientation);
+    gdk_pixbuf_set_option (preview, "orientation", value);
+    g_free (value);
+
+    scaled = gdk_pixbuf_apply_embedded_orientation (preview);
+    g_object_unref (preview);
+    preview = scaled;
+
+    if (orientation >= 5 && orientation <= 8)
+    {
+        gint tmp = width;
+        width = height;
+        height = tmp;
+    }
+
+    /* Some formats don't record the size; go by the preview then */
+    if (width <= 0 || height <= 0)
+    {
+        width = gdk_pixbuf_get_width (preview);
+        height = gdk_pixbuf_get_height (preview);
+    }
+
+    vnr_tools_fit_to_size (&width, &height, job->max_width, job->max_height);
+
+    /* Thumbnails blown up to fill the view look worse than nothing */
+    if (gdk_pixbuf_get_width (preview) * 2 < width)
+    {
+        g_object_unref (preview);
+        return FALSE;
+    }
+
+    scaled = gdk_pixbuf_scale_simple (preview, width, height, GDK_INTERP_BILINEAR);
+    g_object_unref (preview);
+
+    if (scaled == NULL)
+        return FALSE;
+
+    area.width = width;
+    area.height = height;
+    vnr_loader_post_progress (scaled, &area, task);
+    g_object_unref (scaled);
+
+    return TRUE;
+}
+
+/* The EXIF orientation the loader found, 1 if there is none. Frames
+ * of animations are always shown as stored. */
+static gint
+vnr_loader_get_orientation (GdkPixbufAnimation *anim)
+{
+    const gchar *value;
+    gint orientation;
+
+    if (!gdk_pixbuf_animation_is_static_image (anim))
+        return 1;
+
+    value = gdk_pixbuf_get_option (gdk_pixbuf_animation_get_static_image (anim),
+                                   "orientation");
+    if (value == NULL)
+        return 1;
+
+    orientation = atoi (value);
+    return orientation >= 1 && orientation <= 8 ? orientation : 1;
+}
+
+/* Runs in a GTask worker thread. Nothing in here may touch GTK+.
+ * The file is read exactly once; the same buffer is decoded here and
+ * later handed to Exiv2 by the properties dialog. */
+static void
+vnr_loader_thread (GTask *task,
+                   gpointer source_object,
+                   gpointer task_data,
+                   GCancellable *cancellable)
+{
+    VnrLoaderJob *job = task_data;
+    const gchar *path = job->path;
+    VnrDecodeRequest request = { 0, };
+    GdkPixbufAnimation *anim;
+    VnrImage *image;
+    GBytes *data = NULL;
+    gint width, height;
+    gint full_width, full_height;
+    gchar *contents;
+    gsize length;
+    gint64 mtime = 0;
+    goffset file_size = -1;
+    GError *error = NULL;
+
+    if (g_task_return_error_if_cancelled (task))
+        return;
+
+    /* Stamped before reading, so that a file written meanwhile looks
+     * changed rather than the other way round */
+    vnr_image_query_stamp (path, &mtime, &file_size);
+
+    request.path = path;
+    request.max_width = job->max_width;
+    request.max_height = job->max_height;
+    request.cancellable = cancellable;
+
+    /* Region decoders read the file themselves */
+    anim = vnr_decoder_decode (&request, &error);
+
+    if (anim == NULL && error == NULL)
+    {
+        if (file_size >= 0)
+        {
+            image = vnr_disk_cache_lookup (path, mtime, file_size,
+                                           job->max_width, job->max_height);
+            if (image != NULL)
+            {
+                g_task_return_pointer (task, image, (GDestroyNotify) vnr_image_unref);
+                return;
+            }
+        }
+
+        if (!g_file_get_contents (path, &contents, &length, &error))
+        {
+            g_task_return_error (task, error);
+            return;
+        }
+        data = g_bytes_new_take (contents, length);
+
+        if (g_task_return_error_if_cancelled (task))
+        {
+            g_bytes_unref (data);
+            return;
+        }
+
+        /* A preview needs a size to be fitted at, and makes the partial
+         * decode pointless to show. */
+        if (job->progress != NULL
+            && !(job->max_width > 0 && job->max_height > 0
+                 && vnr_loader_show_preview (task, data)))
+        {
+            request.progress = vnr_loader_post_progress;
+            request.progress_data = task;
+        }
+
+        request.data = data;
+        anim = vnr_decoder_decode (&request, &error);
+    }
+
+    if (anim == NULL)
+    {
+        if (error == NULL)
+        {
+            gchar *name = g_filename_display_basename (path);
+            g_set_error (&error, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_CORRUPT_IMAGE,
+                         _("Failed to load image '%s': reason not known, probably a corrupt image file"),
+                         name);
+            g_free (name);
+        }
+        if (data != NULL)
+            g_bytes_unref (data);
+        g_task_return_error (task, error);
+        return;
+    }
+
+    image = vnr_image_new ();
+    image->path = g_strdup (path);
+    image->data = data;
+    image->tiled = request.tiled;
+    image->mtime = mtime;
+    image->file_size = file_size;
+
+    /* A newer request superseded this one while we were decoding */
+    if (g_task_return_error_if_cancelled (task))
+    {
+        g_object_unref (anim);
+        vnr_image_unref (image);
+        return;
+    }
+
+    if (request.format != NULL && gdk_pixbuf_format_is_writable (request.format))
+        image->writable_format_name = gdk_pixbuf_format_get_name (request.format);
+
+    width = gdk_pixbuf_animation_get_width (anim);
+    height = gdk_pixbuf_animation_get_height (anim);
+    full_width = request.full_width;
+    full_height = request.full_height;
+
+    if (full_width > 0 && (width != full_width || height != full_height)
+        && gdk_pixbuf_animation_is_static_image (anim))
+        image->reduced = TRUE;
+
+    image->anim = anim;
+    image->orientation = vnr_loader_get_orientation (anim);
+
+    if (!image->reduced)
+    {
+        full_width = width;
+        full_height = height;
+    }
+
+    /* Report the size of the file in the orientation it is shown in */
+    if (UNI_ORIENTATION_IS_TRANSPOSED (image->orientation))
+    {
+        image->width = full_height;
+        image->height = full_width;
+    }
+    else
+    {
+        image->width = full_width;
+        image->height = full_height;
+    }
+
+    /* Tiled images are never read whole, so there is nothing to keep */
+    if (file_size >= 0 && image->tiled == NULL)
+        vnr_disk_cache_store_async (image);
+
+    g_task_return_pointer (task, image, (GDestroyNotify) vnr_image_unref);
+}
+
+/*************************************************************/
+/***** Actions ***********************************************/
+/*************************************************************/
+
+static VnrLoaderJob *
+vnr_loader_job_new (const gchar *path, gint max_width, gint max_height)
+{
+    VnrLoaderJob *job = g_slice_new0 (VnrLoaderJob);
+
+    job->path = g_strdup (path);
+    job->max_width = max_width;
+    job->max_height = max_height;
+
+    return job;
+}
+
+/**
+ * vnr_loader_load_async:
+ * @path: the file to decode
+ * @max_width: width of the area the image is going to be fitted in, or
+ *   0 to always decode the image at full size
+ * @max_height: height of that area, or 0
+ * @cancellable: a #GCancellable or %NULL
+ * @progress: called in the main context as parts of the image get
+ *   decoded, or %NULL
+ * @progress_data: data for @progress
+ * @progress_destroy: frees @progress_data once the decode is done
+ * @callback: called in the main context once the image is decoded
+ * @user_data: data for @callback
+ *
+ * Decodes @path on a worker thread. Cancelling @cancellable makes the
+ * result report %G_IO_ERROR_CANCELLED, even if the decode itself had
+ * already finished, so the caller never sees a stale image. Progress
+ * updates stop as soon as @cancellable is cancelled.
+ *
+ * Given a target size, large static images are decoded at a reduced
+ * size that still covers it, and the result is flagged as reduced.
+ **/
+void
+vnr_loader_load_async (const gchar *path,
+                       gint max_width,
+                       gint max_height,
+                       GCancellable *cancellable,
+                       VnrLoaderProgressFunc progress,
+                       gpointer progress_data,
+                       GDestroyNotify progress_destroy,
+                       GAsyncReadyCallback callback,
+                       gpointer user_data)
+{
+    VnrLoaderJob *job;
+    GTask *task;
+
+    job = vnr_loader_job_new (path, max_width, max_height);
+    job->progress = progress;
+    job->progress_data = progress_data;
+    job->progress_destroy = progress_destroy;
+
+    task = g_task_new (NULL, cancellable, callback, user_data);
+    g_task_set_source_tag (task, vnr_loader_load_async);
+    g_task_set_task_data (task, job, (GDestroyNotify) vnr_loader_job_free);
+    g_task_run_in_thread (task, vnr_loader_thread);
+    g_object_unref (task);
+}
+
+/**
+ * vnr_loader_load_finish:
+ * @result: the #GAsyncResult passed to the callback
+ * @error: return location for a #GError
+ * @returns: a new reference to the decoded #VnrImage, or %NULL on
+ *   error.
+ **/
+VnrImage *
+vnr_loader_load_finish (GAsyncResult *result, GError **error)
+{
+    g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+    return g_task_propagate_pointer (G_TASK (result), error);
+}
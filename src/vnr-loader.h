@@ -0,0 +1,120 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VNR_LOADER_H__
+#define __VNR_LOADER_H__
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include "uni-tiled-source.h"
+
+G_BEGIN_DECLS
+
+typedef struct _VnrImage VnrImage;
+
+/**
+ * VnrImage:
+ *
+ * The outcome of decoding one file: the animation to display and the
+ * bits of information vnr_window_open() used to gather by probing the
+ * file itself. Instances are reference counted and immutable once
+ * returned by vnr_loader_load_finish().
+ **/
+struct _VnrImage {
+    gint ref_count;
+
+    gchar *path;
+    GdkPixbufAnimation *anim;
+
+    /* The file as it was read from disk. Everything else that needs
+     * the file's contents, such as the metadata reader, works from
+     * this buffer instead of reading the file again. */
+    GBytes *data;
+
+    /* Modification time, in microseconds, and size of the file when
+     * it was read; see vnr_image_check_async() */
+    gint64 mtime;
+    goffset file_size;
+
+    /* Name of the gdk-pixbuf format if it can also be written,
+     * otherwise %NULL. */
+    gchar *writable_format_name;
+
+    /* Size of the image in the file, as it is to be shown */
+    gint width;
+    gint height;
+
+    /* EXIF orientation @anim is to be shown in. The pixels are left
+     * as stored; the view turns them while drawing. */
+    gint orientation;
+
+    /* Whether @anim was decoded at less than the full size */
+    gboolean reduced;
+
+    /* For images too large to decode whole, the full resolution that
+     * @anim is a rendition of. @data is %NULL then. */
+    UniTiledSource *tiled;
+};
+
+/**
+ * VnrLoaderProgressFunc:
+ * @pixbuf: the pixbuf being decoded into
+ * @x: left edge of the area decoded since the last call
+ * @y: top edge of that area
+ * @width: width of that area
+ * @height: height of that area
+ * @user_data: the data passed to vnr_loader_load_async()
+ *
+ * Reports a partially decoded image. The same @pixbuf is passed on
+ * every call of one decode.
+ **/
+typedef void (*VnrLoaderProgressFunc) (GdkPixbuf *pixbuf,
+                                       gint x, gint y,
+                                       gint width, gint height,
+                                       gpointer user_data);
+
+VnrImage*   vnr_image_new           (void);
+VnrImage*   vnr_image_ref           (VnrImage *image);
+void        vnr_image_unref         (VnrImage *image);
+gsize       vnr_image_size          (VnrImage *image);
+
+void        vnr_image_check_async   (VnrImage *image,
+                                     GCancellable *cancellable,
+                                     GAsyncReadyCallback callback,
+                                     gpointer user_data);
+
+gboolean    vnr_image_check_finish  (GAsyncResult *result,
+                                     GError **error);
+
+void        vnr_loader_load_async   (const gchar *path,
+                                     gint max_width,
+                                     gint max_height,
+                                     GCancellable *cancellable,
+                                     VnrLoaderProgressFunc progress,
+                                     gpointer progress_data,
+                                     GDestroyNotify progress_destroy,
+                                     GAsyncReadyCallback callback,
+                                     gpointer user_data);
+
+VnrImage*   vnr_loader_load_finish  (GAsyncResult *result,
+                                     GError **error);
+
+G_END_DECLS
+#endif /* __VNR_LOADER_H__ */
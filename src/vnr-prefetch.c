@@ -0,0 +1,759 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "vnr-prefetch.h"
+#include "vnr-file.h"
+
+typedef struct {
+    gchar *path;
+
+    /* Decoded image, once the decode has finished */
+    VnrImage *image;
+    gsize size;
+
+    /* Set while the decode is running */
+    GCancellable *cancellable;
+
+    /* GTasks of vnr_prefetch_load_async() waiting for this entry */
+    GSList *waiters;
+
+    /* Distance from the current file in decode order, 0 being the
+     * current file itself, or -1 if the entry is no longer wanted. */
+    gint rank;
+} VnrPrefetchEntry;
+
+typedef struct {
+    VnrPrefetch *prefetch;
+    GCancellable *cancellable;
+    gchar *path;
+} VnrPrefetchJob;
+
+/* Task data of a GTask of vnr_prefetch_load_async() */
+typedef struct {
+    VnrPrefetch *prefetch;
+    gchar *path;
+
+    /* Handed to the decode if one has to be started */
+    VnrLoaderProgressFunc progress;
+    gpointer progress_data;
+    GDestroyNotify progress_destroy;
+
+    /* Decoded image being checked against the file, if any */
+    VnrImage *image;
+
+    /* Handler on the caller's cancellable, or 0 */
+    gulong cancelled_id;
+} VnrPrefetchWaiter;
+
+static void vnr_prefetch_pump (VnrPrefetch *prefetch);
+
+/*************************************************************/
+/***** Private actions ***************************************/
+/*************************************************************/
+
+static void
+vnr_prefetch_entry_free (VnrPrefetchEntry *entry)
+{
+    if (entry->cancellable)
+    {
+        g_cancellable_cancel (entry->cancellable);
+        g_object_unref (entry->cancellable);
+    }
+    if (entry->image)
+        vnr_image_unref (entry->image);
+    g_free (entry->path);
+    g_slice_free (VnrPrefetchEntry, entry);
+}
+
+static gboolean
+vnr_prefetch_has_waiters (VnrPrefetch *prefetch)
+{
+    GHashTableIter iter;
+    VnrPrefetchEntry *entry;
+
+    g_hash_table_iter_init (&iter, prefetch->entries);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+        if (entry->waiters != NULL)
+            return TRUE;
+
+    return FALSE;
+}
+
+static gsize
+vnr_prefetch_used (VnrPrefetch *prefetch)
+{
+    GHashTableIter iter;
+    VnrPrefetchEntry *entry;
+    gsize used = 0;
+
+    g_hash_table_iter_init (&iter, prefetch->entries);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+        used += entry->size;
+
+    return used;
+}
+
+/* Drops decoded neighbours, farthest first, until the ring fits in the
+ * budget again. The current file is never dropped. */
+static void
+vnr_prefetch_trim (VnrPrefetch *prefetch)
+{
+    gsize used = vnr_prefetch_used (prefetch);
+
+    while (used > prefetch->budget)
+    {
+        GHashTableIter iter;
+        VnrPrefetchEntry *entry;
+        VnrPrefetchEntry *victim = NULL;
+
+        g_hash_table_iter_init (&iter, prefetch->entries);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+        {
+            if (entry->image == NULL || entry->rank == 0 || entry->waiters)
+                continue;
+            if (victim == NULL || entry->rank < 0
+                || (victim->rank >= 0 && entry->rank > victim->rank))
+                victim = entry;
+        }
+
+        if (victim == NULL)
+            break;
+
+        used -= victim->size;
+        g_hash_table_remove (prefetch->entries, victim->path);
+    }
+}
+
+static void
+vnr_prefetch_waiter_free (VnrPrefetchWaiter *waiter)
+{
+    if (waiter->progress_destroy)
+        waiter->progress_destroy (waiter->progress_data);
+    if (waiter->image)
+        vnr_image_unref (waiter->image);
+    g_free (waiter->path);
+    g_slice_free (VnrPrefetchWaiter, waiter);
+}
+
+static void
+vnr_prefetch_complete_waiters (GSList *waiters,
+                               VnrImage *image,
+                               const GError *error)
+{
+    GSList *item;
+
+    waiters = g_slist_reverse (waiters);
+
+    for (item = waiters; item != NULL; item = item->next)
+    {
+        GTask *task = item->data;
+        VnrPrefetchWaiter *waiter = g_task_get_task_data (task);
+
+        g_cancellable_disconnect (g_task_get_cancellable (task),
+                                  waiter->cancelled_id);
+
+        if (image != NULL)
+            g_task_return_pointer (task, vnr_image_ref (image),
+                                   (GDestroyNotify) vnr_image_unref);
+        else
+            g_task_return_error (task, g_error_copy (error));
+        g_object_unref (task);
+    }
+
+    g_slist_free (waiters);
+}
+
+static void
+vnr_prefetch_decode_cb (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    VnrPrefetchJob *job = user_data;
+    VnrPrefetch *prefetch;
+    VnrPrefetchEntry *entry;
+    VnrImage *image;
+    GSList *waiters;
+    GError *error = NULL;
+
+    image = vnr_loader_load_finish (result, &error);
+
+    /* The entry was dropped, possibly along with the whole prefetcher */
+    if (g_cancellable_is_cancelled (job->cancellable))
+        goto out;
+
+    prefetch = job->prefetch;
+    entry = g_hash_table_lookup (prefetch->entries, job->path);
+    g_assert (entry != NULL && entry->cancellable == job->cancellable);
+
+    g_clear_object (&entry->cancellable);
+    if (prefetch->running == entry)
+        prefetch->running = NULL;
+
+    waiters = entry->waiters;
+    entry->waiters = NULL;
+
+    /* Settle the ring before running the callbacks, which may well
+     * re-centre it. Failures are not remembered: the file may still be
+     * being written and a later visit should retry. */
+    if (image == NULL || entry->rank < 0)
+    {
+        g_hash_table_remove (prefetch->entries, job->path);
+    }
+    else
+    {
+        entry->image = vnr_image_ref (image);
+        entry->size = vnr_image_size (image);
+        vnr_prefetch_trim (prefetch);
+    }
+
+    if (image != NULL)
+        vnr_image_cache_insert (prefetch->cache, image);
+
+    vnr_prefetch_complete_waiters (waiters, image, error);
+    vnr_prefetch_pump (prefetch);
+
+out:
+    if (image)
+        vnr_image_unref (image);
+    g_clear_error (&error);
+    g_object_unref (job->cancellable);
+    g_free (job->path);
+    g_slice_free (VnrPrefetchJob, job);
+}
+
+static void
+vnr_prefetch_start (VnrPrefetch *prefetch,
+                    VnrPrefetchEntry *entry,
+                    VnrLoaderProgressFunc progress,
+                    gpointer progress_data,
+                    GDestroyNotify progress_destroy)
+{
+    VnrPrefetchJob *job;
+
+    g_assert (entry->image == NULL && entry->cancellable == NULL);
+
+    entry->cancellable = g_cancellable_new ();
+
+    job = g_slice_new (VnrPrefetchJob);
+    job->prefetch = prefetch;
+    job->cancellable = g_object_ref (entry->cancellable);
+    job->path = g_strdup (entry->path);
+
+    vnr_loader_load_async (entry->path,
+                           prefetch->target_width, prefetch->target_height,
+                           entry->cancellable,
+                           progress, progress_data, progress_destroy,
+                           vnr_prefetch_decode_cb, job);
+}
+
+/* Starts the next background decode, unless one is running already,
+ * something in the foreground is waiting, or the budget is used up. */
+static void
+vnr_prefetch_pump (VnrPrefetch *prefetch)
+{
+    while (prefetch->running == NULL && !g_queue_is_empty (prefetch->queue))
+    {
+        gchar *path;
+        VnrPrefetchEntry *entry;
+
+        if (vnr_prefetch_has_waiters (prefetch))
+            return;
+        if (vnr_prefetch_used (prefetch) >= prefetch->budget)
+            return;
+
+        path = g_queue_pop_head (prefetch->queue);
+        entry = g_hash_table_lookup (prefetch->entries, path);
+        g_free (path);
+
+        if (entry == NULL || entry->image || entry->cancellable)
+            continue;
+
+        prefetch->running = entry;
+        vnr_prefetch_start (prefetch, entry, NULL, NULL, NULL);
+    }
+}
+
+/* Fills @entry from the image cache, if it has the file */
+static gboolean
+vnr_prefetch_adopt (VnrPrefetch *prefetch, VnrPrefetchEntry *entry)
+{
+    VnrImage *image;
+
+    image = vnr_image_cache_lookup (prefetch->cache, entry->path,
+                                    prefetch->target_width <= 0);
+    if (image == NULL)
+        return FALSE;
+
+    entry->image = image;
+    entry->size = vnr_image_size (image);
+    return TRUE;
+}
+
+static void
+vnr_prefetch_want (VnrPrefetch *prefetch, VnrFile *file, gint rank)
+{
+    VnrPrefetchEntry *entry;
+
+    entry = g_hash_table_lookup (prefetch->entries, file->path);
+
+    if (entry != NULL)
+    {
+        /* With a short list the same file is both before and after the
+         * current one; keep the nearest rank. */
+        if (entry->rank < 0 || rank < entry->rank)
+            entry->rank = rank;
+    }
+    else
+    {
+        entry = g_slice_new0 (VnrPrefetchEntry);
+        entry->path = g_strdup (file->path);
+        entry->rank = rank;
+        g_hash_table_insert (prefetch->entries, entry->path, entry);
+    }
+
+    if (rank > 0 && entry->image == NULL && entry->cancellable == NULL
+        && !vnr_prefetch_adopt (prefetch, entry))
+        g_queue_push_tail (prefetch->queue, g_strdup (file->path));
+}
+
+/* The caller of vnr_prefetch_load_async() gave up on @task. It is
+ * completed right away, and the decode it was waiting for is stopped
+ * if nobody else waits for it and the file is not a neighbour worth
+ * keeping. Either way background decodes may go on again. */
+static void
+vnr_prefetch_waiter_cancelled (GCancellable *cancellable, GTask *task)
+{
+    VnrPrefetchWaiter *waiter = g_task_get_task_data (task);
+    VnrPrefetch *prefetch = waiter->prefetch;
+    VnrPrefetchEntry *entry;
+
+    entry = g_hash_table_lookup (prefetch->entries, waiter->path);
+    if (entry == NULL || g_slist_find (entry->waiters, task) == NULL)
+        return;
+
+    entry->waiters = g_slist_remove (entry->waiters, task);
+
+    if (entry->waiters == NULL && entry->rank < 0)
+    {
+        if (prefetch->running == entry)
+            prefetch->running = NULL;
+        g_hash_table_remove (prefetch->entries, waiter->path);
+    }
+
+    /* The handler can't be disconnected from within itself; it is
+     * never run again anyway. */
+    waiter->cancelled_id = 0;
+
+    g_task_return_error_if_cancelled (task);
+    g_object_unref (task);
+
+    vnr_prefetch_pump (prefetch);
+}
+
+static void vnr_prefetch_checked_cb (GObject *source,
+                                     GAsyncResult *result,
+                                     gpointer user_data);
+
+/* Answers @task from the ring or the image cache, or else makes it wait
+ * for a decode of the file, joining the running one if there is one.
+ * Unless @checked, an image that is decoded already is first checked
+ * against the file. */
+static void
+vnr_prefetch_serve (VnrPrefetch *prefetch, GTask *task, gboolean checked)
+{
+    VnrPrefetchWaiter *waiter = g_task_get_task_data (task);
+    VnrPrefetchEntry *entry;
+    GCancellable *cancellable;
+
+    entry = g_hash_table_lookup (prefetch->entries, waiter->path);
+
+    /* Decoded for a fitting view, but now wanted at full size */
+    if (entry != NULL && entry->image != NULL
+        && entry->image->reduced && prefetch->target_width <= 0)
+    {
+        g_hash_table_remove (prefetch->entries, waiter->path);
+        entry = NULL;
+    }
+
+    if (entry == NULL)
+    {
+        entry = g_slice_new0 (VnrPrefetchEntry);
+        entry->path = g_strdup (waiter->path);
+        entry->rank = -1;
+        g_hash_table_insert (prefetch->entries, entry->path, entry);
+    }
+
+    if (entry->image == NULL && entry->cancellable == NULL)
+        vnr_prefetch_adopt (prefetch, entry);
+
+    if (entry->image != NULL && !checked)
+    {
+        waiter->image = vnr_image_ref (entry->image);
+        vnr_image_check_async (waiter->image, prefetch->checks,
+                               vnr_prefetch_checked_cb, task);
+        return;
+    }
+
+    if (entry->image != NULL)
+    {
+        g_task_return_pointer (task, vnr_image_ref (entry->image),
+                               (GDestroyNotify) vnr_image_unref);
+        g_object_unref (task);
+        return;
+    }
+
+    entry->waiters = g_slist_prepend (entry->waiters, task);
+
+    if (entry->cancellable == NULL)
+    {
+        vnr_prefetch_start (prefetch, entry, waiter->progress,
+                            waiter->progress_data, waiter->progress_destroy);
+        waiter->progress_destroy = NULL;
+    }
+
+    cancellable = g_task_get_cancellable (task);
+    if (cancellable != NULL)
+        waiter->cancelled_id =
+            g_cancellable_connect (cancellable,
+                                   G_CALLBACK (vnr_prefetch_waiter_cancelled),
+                                   task, NULL);
+}
+
+/* The decoded image of @task was checked against the file. If the file
+ * changed since, it is forgotten and decoded again. */
+static void
+vnr_prefetch_checked_cb (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    GTask *task = user_data;
+    VnrPrefetchWaiter *waiter = g_task_get_task_data (task);
+    VnrPrefetch *prefetch;
+    VnrPrefetchEntry *entry;
+    gboolean current;
+    GError *error = NULL;
+
+    current = vnr_image_check_finish (result, &error);
+
+    /* Only the prefetcher going away cancels checks */
+    if (error != NULL)
+    {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    if (g_task_return_error_if_cancelled (task))
+    {
+        g_object_unref (task);
+        return;
+    }
+
+    if (current)
+    {
+        g_task_return_pointer (task, vnr_image_ref (waiter->image),
+                               (GDestroyNotify) vnr_image_unref);
+        g_object_unref (task);
+        return;
+    }
+
+    prefetch = waiter->prefetch;
+    vnr_image_cache_invalidate (prefetch->cache, waiter->path);
+
+    entry = g_hash_table_lookup (prefetch->entries, waiter->path);
+    if (entry != NULL && entry->image == waiter->image)
+        g_hash_table_remove (prefetch->entries, waiter->path);
+
+    g_clear_pointer (&waiter->image, vnr_image_unref);
+    vnr_prefetch_serve (prefetch, task, TRUE);
+}
+
+/*************************************************************/
+/***** Actions ***********************************************/
+/*************************************************************/
+
+/**
+ * vnr_prefetch_new:
+ * @cache: the cache to share decoded images with. It must outlive the
+ *   prefetcher.
+ **/
+VnrPrefetch *
+vnr_prefetch_new (VnrImageCache *cache)
+{
+    VnrPrefetch *prefetch = g_slice_new0 (VnrPrefetch);
+
+    prefetch->entries = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                               (GDestroyNotify) vnr_prefetch_entry_free);
+    prefetch->queue = g_queue_new ();
+    prefetch->checks = g_cancellable_new ();
+    prefetch->cache = cache;
+    prefetch->n_next = 2;
+    prefetch->n_prev = 1;
+    prefetch->budget = 256 * 1024 * 1024;
+
+    return prefetch;
+}
+
+void
+vnr_prefetch_free (VnrPrefetch *prefetch)
+{
+    GHashTableIter iter;
+    VnrPrefetchEntry *entry;
+    GError *error = NULL;
+
+    if (prefetch == NULL)
+        return;
+
+    g_set_error_literal (&error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                         "Prefetcher destroyed");
+
+    g_hash_table_iter_init (&iter, prefetch->entries);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+    {
+        vnr_prefetch_complete_waiters (entry->waiters, NULL, error);
+        entry->waiters = NULL;
+    }
+
+    g_error_free (error);
+
+    g_cancellable_cancel (prefetch->checks);
+    g_object_unref (prefetch->checks);
+
+    g_hash_table_destroy (prefetch->entries);
+    g_queue_free_full (prefetch->queue, g_free);
+    g_slice_free (VnrPrefetch, prefetch);
+}
+
+/**
+ * vnr_prefetch_set_limits:
+ * @n_next: how many files after the current one to keep decoded
+ * @n_prev: how many files before the current one to keep decoded
+ * @budget: the most bytes the decoded neighbours may take
+ *
+ * Takes effect on the next vnr_prefetch_set_position().
+ **/
+void
+vnr_prefetch_set_limits (VnrPrefetch *prefetch,
+                         gint n_next,
+                         gint n_prev,
+                         gsize budget)
+{
+    prefetch->n_next = MAX (n_next, 0);
+    prefetch->n_prev = MAX (n_prev, 0);
+    prefetch->budget = budget;
+}
+
+/**
+ * vnr_prefetch_set_target_size:
+ * @width: width of the area images are going to be fitted in, or 0 to
+ *   decode them at full size
+ * @height: height of that area, or 0
+ *
+ * Sets the size decodes started from now on aim at. See
+ * vnr_loader_load_async().
+ **/
+void
+vnr_prefetch_set_target_size (VnrPrefetch *prefetch, gint width, gint height)
+{
+    prefetch->target_width = width;
+    prefetch->target_height = height;
+}
+
+/**
+ * vnr_prefetch_set_position:
+ * @current: the link of the file list that is being displayed
+ *
+ * Re-centres the ring on @current. Neighbours that fall out of the
+ * ring are dropped, running decodes of them cancelled, and the missing
+ * ones are queued nearest first, alternating between the files after
+ * and before @current. The list wraps around, like the navigation
+ * does.
+ **/
+void
+vnr_prefetch_set_position (VnrPrefetch *prefetch, GList *current)
+{
+    GHashTableIter iter;
+    VnrPrefetchEntry *entry;
+    GList *next, *prev;
+    gint i, rank = 0;
+
+    g_return_if_fail (current != NULL);
+
+    g_hash_table_iter_init (&iter, prefetch->entries);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+        entry->rank = -1;
+    g_queue_foreach (prefetch->queue, (GFunc) g_free, NULL);
+    g_queue_clear (prefetch->queue);
+
+    vnr_prefetch_want (prefetch, current->data, rank++);
+
+    next = prev = current;
+    for (i = 0; i < MAX (prefetch->n_next, prefetch->n_prev); i++)
+    {
+        if (i < prefetch->n_next)
+        {
+            next = g_list_next (next);
+            if (next == NULL)
+                next = g_list_first (current);
+            vnr_prefetch_want (prefetch, next->data, rank++);
+        }
+        if (i < prefetch->n_prev)
+        {
+            prev = g_list_previous (prev);
+            if (prev == NULL)
+                prev = g_list_last (current);
+            vnr_prefetch_want (prefetch, prev->data, rank++);
+        }
+    }
+
+    /* Unwanted entries go, unless a foreground request still waits for
+     * them; those are removed once their decode finishes. */
+    g_hash_table_iter_init (&iter, prefetch->entries);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+    {
+        if (entry->rank >= 0 || entry->waiters != NULL)
+            continue;
+        if (prefetch->running == entry)
+            prefetch->running = NULL;
+        g_hash_table_iter_remove (&iter);
+    }
+
+    vnr_prefetch_trim (prefetch);
+    vnr_prefetch_pump (prefetch);
+}
+
+/**
+ * vnr_prefetch_forget:
+ * @path: a file that changed on disk
+ *
+ * Drops whatever is decoded for @path, here and in the image cache, so
+ * that the next load reads the file again.
+ **/
+void
+vnr_prefetch_forget (VnrPrefetch *prefetch, const gchar *path)
+{
+    VnrPrefetchEntry *entry = g_hash_table_lookup (prefetch->entries, path);
+
+    vnr_image_cache_invalidate (prefetch->cache, path);
+
+    if (entry == NULL || entry->waiters != NULL)
+        return;
+
+    if (prefetch->running == entry)
+        prefetch->running = NULL;
+    g_hash_table_remove (prefetch->entries, path);
+    vnr_prefetch_pump (prefetch);
+}
+
+/**
+ * vnr_prefetch_load_async:
+ * @path: the file to decode
+ * @cancellable: a #GCancellable or %NULL
+ * @progress: called as parts of the image get decoded, or %NULL
+ * @progress_data: data for @progress
+ * @progress_destroy: frees @progress_data
+ * @callback: called in the main context once the image is available
+ * @user_data: data for @callback
+ *
+ * Like vnr_loader_load_async(), but serves @path from the ring or the
+ * image cache when it is already decoded and joins the background
+ * decode when one is under way, instead of decoding the file a second
+ * time. Background decodes are held back until the callback has run.
+ *
+ * An image that is decoded already is handed out once a worker thread
+ * found that its file didn't change since; otherwise the file is
+ * decoded again.
+ *
+ * @progress is only used when a new decode has to be started; joining
+ * a running decode reports the finished image only.
+ *
+ * Cancelling @cancellable completes the request at once. The decode
+ * is stopped too, unless another request waits for it or the file is
+ * one of the neighbours set with vnr_prefetch_set_position().
+ **/
+void
+vnr_prefetch_load_async (VnrPrefetch *prefetch,
+                         const gchar *path,
+                         GCancellable *cancellable,
+                         VnrLoaderProgressFunc progress,
+                         gpointer progress_data,
+                         GDestroyNotify progress_destroy,
+                         GAsyncReadyCallback callback,
+                         gpointer user_data)
+{
+    VnrPrefetchWaiter *waiter;
+    GTask *task;
+
+    task = g_task_new (NULL, cancellable, callback, user_data);
+    g_task_set_source_tag (task, vnr_prefetch_load_async);
+    g_task_set_check_cancellable (task, TRUE);
+
+    waiter = g_slice_new0 (VnrPrefetchWaiter);
+    waiter->prefetch = prefetch;
+    waiter->path = g_strdup (path);
+    waiter->progress = progress;
+    waiter->progress_data = progress_data;
+    waiter->progress_destroy = progress_destroy;
+    g_task_set_task_data (task, waiter,
+                          (GDestroyNotify) vnr_prefetch_waiter_free);
+
+    if (g_task_return_error_if_cancelled (task))
+    {
+        g_object_unref (task);
+        return;
+    }
+
+    vnr_prefetch_serve (prefetch, task, FALSE);
+}
+
+/**
+ * vnr_prefetch_is_ready:
+ * @prefetch: a #VnrPrefetch
+ * @path: the file to look up
+ * @returns: whether @path is decoded already, either in the ring or in
+ *   the image cache, so that vnr_prefetch_load_async() has it at once.
+ **/
+gboolean
+vnr_prefetch_is_ready (VnrPrefetch *prefetch, const gchar *path)
+{
+    VnrPrefetchEntry *entry;
+
+    entry = g_hash_table_lookup (prefetch->entries, path);
+    if (entry != NULL)
+        return entry->image != NULL
+               && !(entry->image->reduced && prefetch->target_width <= 0);
+
+    return vnr_image_cache_contains (prefetch->cache, path,
+                                     prefetch->target_width <= 0);
+}
+
+/**
+ * vnr_prefetch_load_finish:
+ * @result: the #GAsyncResult passed to the callback
+ * @error: return location for a #GError
+ * @returns: a new reference to the decoded #VnrImage, or %NULL on
+ *   error.
+ **/
+VnrImage *
+vnr_prefetch_load_finish (VnrPrefetch *prefetch,
+                          GAsyncResult *result,
+                          GError **error)
+{
+    g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+    return g_task_propagate_pointer (G_TASK (result), error);
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VNR_PREFETCH_H__
+#define __VNR_PREFETCH_H__
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "vnr-loader.h"
+#include "vnr-image-cache.h"
+
+G_BEGIN_DECLS
+
+typedef struct _VnrPrefetch VnrPrefetch;
+
+/**
+ * VnrPrefetch:
+ *
+ * Keeps the files around the current position of a file list decoded
+ * ahead of time, so that stepping to the next or previous image does
+ * not have to wait for a decode. Background decodes run one at a time
+ * and only while no foreground request is waiting. The ring is
+ * bounded both by the number of neighbours and by the memory the
+ * decoded images take. Finished decodes are also handed to the
+ * #VnrImageCache, which is asked first for files that are not in the
+ * ring.
+ *
+ * All functions must be called from the main thread.
+ **/
+struct _VnrPrefetch {
+    /* Path -> VnrPrefetchEntry */
+    GHashTable *entries;
+
+    /* Paths still to be decoded, nearest to the current file first */
+    GQueue *queue;
+
+    /* Entry being decoded in the background, if any */
+    gpointer running;
+
+    /* Not owned */
+    VnrImageCache *cache;
+
+    /* Checks of decoded images against their files; cancelled when
+     * the prefetcher is freed */
+    GCancellable *checks;
+
+    gint n_next;
+    gint n_prev;
+    gsize budget;
+
+    /* Passed on to vnr_loader_load_async() */
+    gint target_width;
+    gint target_height;
+};
+
+VnrPrefetch*    vnr_prefetch_new            (VnrImageCache *cache);
+void            vnr_prefetch_free           (VnrPrefetch *prefetch);
+
+void            vnr_prefetch_set_limits     (VnrPrefetch *prefetch,
+                                             gint n_next,
+                                             gint n_prev,
+                                             gsize budget);
+
+void            vnr_prefetch_set_target_size (VnrPrefetch *prefetch,
+                                              gint width,
+                                              gint height);
+
+void            vnr_prefetch_set_position   (VnrPrefetch *prefetch,
+                                             GList *current);
+
+void            vnr_prefetch_forget         (VnrPrefetch *prefetch,
+                                             const gchar *path);
+
+gboolean        vnr_prefetch_is_ready       (VnrPrefetch *prefetch,
+                                             const gchar *path);
+
+void            vnr_prefetch_load_async     (VnrPrefetch *prefetch,
+                                             const gchar *path,
+                                             GCancellable *cancellable,
+                                             VnrLoaderProgressFunc progress,
+                                             gpointer progress_data,
+                                             GDestroyNotify progress_destroy,
+                                             GAsyncReadyCallback callback,
+                                             gpointer user_data);
+
+VnrImage*       vnr_prefetch_load_finish    (VnrPrefetch *prefetch,
+                                             GAsyncResult *result,
+                                             GError **error);
+
+G_END_DECLS
+#endif /* __VNR_PREFETCH_H__ */
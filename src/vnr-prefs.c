@@ -171,11 +171,35 @@ vnr_prefs_set_default(VnrPrefs *prefs)
     prefs->start_slideshow = FALSE;
     prefs->start_fullscreen = FALSE;
     prefs->auto_resize = FALSE;
+    prefs->prefetch_next = 2;
+    prefs->prefetch_previous = 1;
+    prefs->prefetch_memory = 256;
+    prefs->image_cache_memory = 128;
+    prefs->disk_cache_size = 0;
 #ifdef HAVE_WALLPAPER
     prefs->desktop = VNR_PREFS_DESKTOP_GNOME3;
 #endif /* HAVE_WALLPAPER */
 }
 
+/* Keys that older config files lack fall back to their default instead
+ * of resetting every other preference. */
+static gint
+vnr_prefs_get_optional_integer (GKeyFile *conf, const gchar *key, gint default_value)
+{
+    GError *error = NULL;
+    gint value;
+
+    value = g_key_file_get_integer (conf, "prefs", key, &error);
+
+    if(error != NULL)
+    {
+        g_error_free (error);
+        return default_value;
+    }
+
+    return value;
+}
+
 static GtkWidget *
 build_dialog (VnrPrefs *prefs)
 {
@@ -378,6 +402,11 @@ vnr_prefs_load (VnrPrefs *prefs)
     prefs->behavior_modify = g_key_file_get_integer (conf, "prefs", "behavior-modify", &error);
     prefs->jpeg_quality = g_key_file_get_integer (conf, "prefs", "jpeg-quality", &error);
     prefs->png_compression = g_key_file_get_integer (conf, "prefs", "png-compression", &error);
+    prefs->prefetch_next = vnr_prefs_get_optional_integer (conf, "prefetch-next", 2);
+    prefs->prefetch_previous = vnr_prefs_get_optional_integer (conf, "prefetch-previous", 1);
+    prefs->prefetch_memory = vnr_prefs_get_optional_integer (conf, "prefetch-memory", 256);
+    prefs->image_cache_memory = vnr_prefs_get_optional_integer (conf, "image-cache-memory", 128);
+    prefs->disk_cache_size = vnr_prefs_get_optional_integer (conf, "disk-cache-size", 0);
 #ifdef HAVE_WALLPAPER
     prefs->desktop = g_key_file_get_integer (conf, "prefs", "desktop", &error);
 #endif /* HAVE_WALLPAPER */
@@ -469,6 +498,11 @@ vnr_prefs_save (VnrPrefs *prefs)
     g_key_file_set_integer (conf, "prefs", "behavior-modify", prefs->behavior_modify);
     g_key_file_set_integer (conf, "prefs", "jpeg-quality", prefs->jpeg_quality);
     g_key_file_set_integer (conf, "prefs", "png-compression", prefs->png_compression);
+    g_key_file_set_integer (conf, "prefs", "prefetch-next", prefs->prefetch_next);
+    g_key_file_set_integer (conf, "prefs", "prefetch-previous", prefs->prefetch_previous);
+    g_key_file_set_integer (conf, "prefs", "prefetch-memory", prefs->prefetch_memory);
+    g_key_file_set_integer (conf, "prefs", "image-cache-memory", prefs->image_cache_memory);
+    g_key_file_set_integer (conf, "prefs", "disk-cache-size", prefs->disk_cache_size);
 #ifdef HAVE_WALLPAPER
     g_key_file_set_integer (conf, "prefs", "desktop", prefs->desktop);
 #else
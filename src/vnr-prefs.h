@@ -105,6 +105,11 @@ struct _VnrPrefs {
     int slideshow_timeout;
     int jpeg_quality;
     int png_compression;
+    int prefetch_next;
+    int prefetch_previous;
+    int prefetch_memory;
+    int image_cache_memory;
+    int disk_cache_size;
 
     GtkWidget *dialog;
     GtkWidget *vnr_win;
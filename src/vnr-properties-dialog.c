@@ -24,6 +24,7 @@
 #include "vnr-properties-dialog.h"
 #include "vnr-file.h"
 #include "vnr-tools.h"
+#include "uni-utils.h"
 #include "uni-exiv2.hpp"
 
 G_DEFINE_TYPE (VnrPropertiesDialog, vnr_properties_dialog, GTK_TYPE_DIALOG);
@@ -43,10 +44,23 @@ key_press_cb (GtkWidget *widget, GdkEventKey *event, gpointer user_data)
 }
 
 static void
-get_file_info(gchar *filename, goffset *size, const gchar **type)
+get_file_info(VnrPropertiesDialog *dialog, gchar *filename, goffset *size, const gchar **type)
 {
     GFile *file;
     GFileInfo *fileinfo;
+    VnrImage *image = dialog->vnr_win->current_image;
+
+    /* Use the contents read when the image was opened */
+    if (image != NULL && image->data != NULL
+        && g_strcmp0 (image->path, filename) == 0)
+    {
+        gsize length;
+        const guchar *data = g_bytes_get_data (image->data, &length);
+
+        *size = length;
+        *type = g_content_type_guess (filename, data, length, NULL);
+        return;
+    }
 
     file = g_file_new_for_path(filename);
     fileinfo = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE","
@@ -80,7 +94,7 @@ set_new_pixbuf(VnrPropertiesDialog *dialog, GdkPixbuf* original)
         return;
     }
 
-    int width, height;
+    int width, height, orientation;
 
     width = gdk_pixbuf_get_width (original);
     height = gdk_pixbuf_get_height (original);
@@ -89,6 +103,16 @@ set_new_pixbuf(VnrPropertiesDialog *dialog, GdkPixbuf* original)
 
     dialog->thumbnail = gdk_pixbuf_scale_simple (original, width, height,
                                                  GDK_INTERP_NEAREST);
+
+    /* Show the thumbnail the way the view shows the image */
+    orientation = UNI_IMAGE_VIEW(dialog->vnr_win->view)->orientation;
+    if(orientation != 1 && dialog->thumbnail != NULL)
+    {
+        GdkPixbuf *turned = uni_pixbuf_apply_orientation (dialog->thumbnail,
+                                                          orientation);
+        g_object_unref(dialog->thumbnail);
+        dialog->thumbnail = turned;
+    }
 }
 
 static void
@@ -258,7 +282,7 @@ vnr_properties_dialog_update(VnrPropertiesDialog *dialog)
     gchar *filetype_desc = NULL;
     gchar *filesize_str = NULL;
 
-    get_file_info ((gchar*)VNR_FILE(dialog->vnr_win->file_list->data)->path,
+    get_file_info (dialog, (gchar*)VNR_FILE(dialog->vnr_win->file_list->data)->path,
                    &filesize, &filetype);
 
     if(filetype == NULL && filesize == 0)
@@ -337,10 +361,24 @@ vnr_cb_add_metadata(const char *label, const char *value, void *user_data) {
 static void
 vnr_properties_dialog_update_metadata(VnrPropertiesDialog *dialog)
 {
+    VnrImage *image = dialog->vnr_win->current_image;
+    const gchar *path = VNR_FILE(dialog->vnr_win->file_list->data)->path;
+
     vnr_properties_dialog_clear_metadata(dialog);
 
+    if (image != NULL && image->data != NULL
+        && g_strcmp0 (image->path, path) == 0)
+    {
+        gsize length;
+        const guchar *data = g_bytes_get_data (image->data, &length);
+
+        uni_read_exiv2_map_from_buffer(data, (long) length,
+                                       vnr_cb_add_metadata, (void*)dialog);
+        return;
+    }
+
     uni_read_exiv2_map(
-        VNR_FILE(dialog->vnr_win->file_list->data)->path, 
+        path, 
         vnr_cb_add_metadata, 
         (void*)dialog);
 }
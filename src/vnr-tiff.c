@@ -0,0 +1,445 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "config.h"
+
+#ifdef HAVE_LIBTIFF
+
+#include <libintl.h>
+#include <glib/gi18n.h>
+#define _(String) gettext (String)
+
+#include <stdio.h>
+#include <glib/gstdio.h>
+#include <tiffio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include "vnr-tiff.h"
+#include "vnr-tools.h"
+
+/* Width of the tiles striped files are cut into, and the height the
+ * strips are gathered to */
+#define VNR_TIFF_BAND_SIZE 256
+
+/* Strips are decoded whole, so files with larger strips are left to
+ * gdk-pixbuf */
+#define VNR_TIFF_MAX_STRIP_BYTES (64 * 1024 * 1024)
+
+/* Images with more pixels than this are read tile by tile, if the file
+ * allows it */
+#define VNR_TIFF_MIN_PIXELS (64 * 1024 * 1024)
+
+/* Size of the rendition of a tiled image when the view won't fit it */
+#define VNR_TIFF_RENDITION_SIZE 2048
+
+typedef struct {
+    TIFF *tif;
+
+    /* Tile size as stored in the file, for tiled files */
+    guint32 file_tile_width;
+    guint32 file_tile_height;
+
+    /* Rows per strip, for striped files */
+    guint32 rows_per_strip;
+} VnrTiff;
+
+/*************************************************************/
+/***** Private actions ***************************************/
+/*************************************************************/
+
+static void
+vnr_tiff_warning_handler (const char *module, const char *fmt, va_list args)
+{
+    /* Unknown tags and the like are no reason to bother the user */
+}
+
+/* Copies one row of a TIFFRGBAImage raster, which holds associated
+ * alpha, into a pixbuf row. */
+static void
+vnr_tiff_convert_row (const guint32 *src, guchar *dst, int width,
+                      gboolean has_alpha)
+{
+    int x;
+
+    for (x = 0; x < width; x++)
+    {
+        guint32 pixel = src[x];
+        guint a = TIFFGetA (pixel);
+
+        if (!has_alpha || a == 255)
+        {
+            dst[0] = TIFFGetR (pixel);
+            dst[1] = TIFFGetG (pixel);
+            dst[2] = TIFFGetB (pixel);
+        }
+        else if (a == 0)
+        {
+            dst[0] = dst[1] = dst[2] = 0;
+        }
+        else
+        {
+            dst[0] = MIN (TIFFGetR (pixel) * 255 / a, 255);
+            dst[1] = MIN (TIFFGetG (pixel) * 255 / a, 255);
+            dst[2] = MIN (TIFFGetB (pixel) * 255 / a, 255);
+        }
+
+        if (has_alpha)
+        {
+            dst[3] = a;
+            dst += 4;
+        }
+        else
+        {
+            dst += 3;
+        }
+    }
+}
+
+static GdkPixbuf *
+vnr_tiff_read_tile (UniTiledSource *source, int col, int row, GError **error)
+{
+    VnrTiff *tiff = source->priv;
+    guint32 x = col * tiff->file_tile_width;
+    guint32 y = row * tiff->file_tile_height;
+    int width = MIN (tiff->file_tile_width, source->width - x);
+    int height = MIN (tiff->file_tile_height, source->height - y);
+    GdkPixbuf *pixbuf;
+    guint32 *raster;
+    int i;
+
+    raster = g_try_new (guint32, (gsize) tiff->file_tile_width
+                                 * tiff->file_tile_height);
+    if (raster == NULL)
+    {
+        g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_NOMEM,
+                             _("Not enough memory to read the image"));
+        return NULL;
+    }
+
+    if (!TIFFReadRGBATile (tiff->tif, x, y, raster))
+    {
+        g_free (raster);
+        g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_IO,
+                             _("The image data is corrupt"));
+        return NULL;
+    }
+
+    pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, source->has_alpha, 8,
+                             width, height);
+    if (pixbuf == NULL)
+    {
+        g_free (raster);
+        g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_NOMEM,
+                             _("Not enough memory to read the image"));
+        return NULL;
+    }
+
+    /* The raster starts at the bottom left corner of the tile */
+    for (i = 0; i < height; i++)
+        vnr_tiff_convert_row (raster + (gsize) (tiff->file_tile_height - 1 - i)
+                                       * tiff->file_tile_width,
+                              gdk_pixbuf_get_pixels (pixbuf)
+                              + i * gdk_pixbuf_get_rowstride (pixbuf),
+                              width, source->has_alpha);
+
+    g_free (raster);
+    return pixbuf;
+}
+
+/* Striped files are decoded a band of whole rows at a time. The band is
+ * cut into tiles, all of which are handed to the source. */
+static GdkPixbuf *
+vnr_tiff_read_band (UniTiledSource *source, int col, int row, GError **error)
+{
+    VnrTiff *tiff = source->priv;
+    int n_cols = (source->width + source->tile_width - 1) / source->tile_width;
+    int top = row * source->tile_height;
+    int height = MIN (source->tile_height, source->height - top);
+    GdkPixbuf **tiles;
+    GdkPixbuf *result = NULL;
+    guint32 *raster;
+    int strip_row, c;
+
+    raster = g_try_new (guint32, (gsize) source->width * tiff->rows_per_strip);
+    tiles = g_new0 (GdkPixbuf *, n_cols);
+
+    for (c = 0; c < n_cols && raster != NULL; c++)
+    {
+        tiles[c] = gdk_pixbuf_new (GDK_COLORSPACE_RGB, source->has_alpha, 8,
+                                   MIN (source->tile_width,
+                                        source->width - c * source->tile_width),
+                                   height);
+        if (tiles[c] == NULL)
+            break;
+    }
+
+    if (raster == NULL || c < n_cols)
+    {
+        g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_NOMEM,
+                             _("Not enough memory to read the image"));
+        goto out;
+    }
+
+    for (strip_row = top; strip_row < top + height; strip_row += tiff->rows_per_strip)
+    {
+        int n_rows = MIN (tiff->rows_per_strip, source->height - strip_row);
+        int i;
+
+        if (!TIFFReadRGBAStrip (tiff->tif, strip_row, raster))
+        {
+            g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_IO,
+                                 _("The image data is corrupt"));
+            goto out;
+        }
+
+        /* Rows come bottom up, within the rows actually read */
+        for (i = 0; i < n_rows; i++)
+        {
+            const guint32 *src = raster + (gsize) (n_rows - 1 - i) * source->width;
+            int dst_row = strip_row - top + i;
+
+            for (c = 0; c < n_cols; c++)
+                vnr_tiff_convert_row (src + c * source->tile_width,
+                                      gdk_pixbuf_get_pixels (tiles[c])
+                                      + dst_row * gdk_pixbuf_get_rowstride (tiles[c]),
+                                      gdk_pixbuf_get_width (tiles[c]),
+                                      source->has_alpha);
+        }
+    }
+
+    for (c = 0; c < n_cols; c++)
+        if (c != col)
+            uni_tiled_source_add_tile (source, c, row, tiles[c]);
+    result = g_object_ref (tiles[col]);
+
+out:
+    for (c = 0; c < n_cols; c++)
+        if (tiles[c] != NULL)
+            g_object_unref (tiles[c]);
+    g_free (tiles);
+    g_free (raster);
+    return result;
+}
+
+static void
+vnr_tiff_finalize (UniTiledSource *source)
+{
+    VnrTiff *tiff = source->priv;
+
+    TIFFClose (tiff->tif);
+    g_slice_free (VnrTiff, tiff);
+}
+
+static const UniTiledSourceClass vnr_tiff_tiled_class = {
+    vnr_tiff_read_tile,
+    vnr_tiff_finalize
+};
+
+static const UniTiledSourceClass vnr_tiff_striped_class = {
+    vnr_tiff_read_band,
+    vnr_tiff_finalize
+};
+
+static gboolean
+vnr_tiff_has_magic (const gchar *path)
+{
+    guchar magic[4];
+    gsize length = 0;
+    FILE *file = g_fopen (path, "rb");
+
+    if (file == NULL)
+        return FALSE;
+
+    length = fread (magic, 1, sizeof magic, file);
+    fclose (file);
+
+    if (length != sizeof magic)
+        return FALSE;
+
+    /* Classic and BigTIFF, in either byte order */
+    return (magic[0] == 'I' && magic[1] == 'I' && magic[3] == 0
+            && (magic[2] == 42 || magic[2] == 43))
+        || (magic[0] == 'M' && magic[1] == 'M' && magic[2] == 0
+            && (magic[3] == 42 || magic[3] == 43));
+}
+
+/*************************************************************/
+/***** Actions ***********************************************/
+/*************************************************************/
+
+/**
+ * vnr_tiff_open:
+ * @path: a file
+ * @min_pixels: the least number of pixels worth reading tile by tile
+ * @returns: a tiled source reading @path, or %NULL if @path is not a
+ *   TIFF file, is smaller than @min_pixels, or is laid out in a way
+ *   that can't be read in parts. Such files are left to gdk-pixbuf.
+ *
+ * Orientation tags are not applied; the image is shown as stored.
+ **/
+UniTiledSource *
+vnr_tiff_open (const gchar *path, gint64 min_pixels)
+{
+    static gsize handlers_set = 0;
+    VnrTiff *tiff;
+    TIFF *tif;
+    guint32 width = 0, height = 0;
+    guint16 n_extra = 0, *extra = NULL;
+    gboolean has_alpha;
+    char message[1024];
+    UniTiledSource *source;
+
+    if (!vnr_tiff_has_magic (path))
+        return NULL;
+
+    if (g_once_init_enter (&handlers_set))
+    {
+        TIFFSetWarningHandler (vnr_tiff_warning_handler);
+        g_once_init_leave (&handlers_set, 1);
+    }
+
+    tif = TIFFOpen (path, "rm");
+    if (tif == NULL)
+        return NULL;
+
+    TIFFGetField (tif, TIFFTAG_IMAGEWIDTH, &width);
+    TIFFGetField (tif, TIFFTAG_IMAGELENGTH, &height);
+
+    if (width == 0 || height == 0 || (gint64) width * height < min_pixels
+        || width > G_MAXINT / 4 || height > G_MAXINT / 4
+        || !TIFFRGBAImageOK (tif, message))
+    {
+        TIFFClose (tif);
+        return NULL;
+    }
+
+    TIFFGetFieldDefaulted (tif, TIFFTAG_EXTRASAMPLES, &n_extra, &extra);
+    has_alpha = n_extra > 0 && (extra[0] == EXTRASAMPLE_ASSOCALPHA
+                                || extra[0] == EXTRASAMPLE_UNASSALPHA);
+
+    tiff = g_slice_new0 (VnrTiff);
+    tiff->tif = tif;
+
+    if (TIFFIsTiled (tif))
+    {
+        TIFFGetField (tif, TIFFTAG_TILEWIDTH, &tiff->file_tile_width);
+        TIFFGetField (tif, TIFFTAG_TILELENGTH, &tiff->file_tile_height);
+
+        if (tiff->file_tile_width == 0 || tiff->file_tile_height == 0)
+            goto unsupported;
+
+        source = uni_tiled_source_new (&vnr_tiff_tiled_class, tiff,
+                                       width, height, has_alpha,
+                                       tiff->file_tile_width,
+                                       tiff->file_tile_height);
+    }
+    else
+    {
+        guint32 rows;
+
+        TIFFGetFieldDefaulted (tif, TIFFTAG_ROWSPERSTRIP, &tiff->rows_per_strip);
+        tiff->rows_per_strip = CLAMP (tiff->rows_per_strip, 1, height);
+
+        if ((gint64) tiff->rows_per_strip * width * 4 > VNR_TIFF_MAX_STRIP_BYTES)
+            goto unsupported;
+
+        rows = MAX (VNR_TIFF_BAND_SIZE / tiff->rows_per_strip, 1)
+               * tiff->rows_per_strip;
+
+        source = uni_tiled_source_new (&vnr_tiff_striped_class, tiff,
+                                       width, height, has_alpha,
+                                       VNR_TIFF_BAND_SIZE, rows);
+    }
+
+    return source;
+
+unsupported:
+    TIFFClose (tif);
+    g_slice_free (VnrTiff, tiff);
+    return NULL;
+}
+
+/* Opens an image too large to be decoded whole and renders a scaled
+ * down rendition of it for display. Once zoomed in beyond that, the
+ * view draws from the tiles of the image instead. Smaller images are
+ * passed on to gdk-pixbuf. */
+static GdkPixbufAnimation *
+vnr_tiff_decode (VnrDecodeRequest *request, GError **error)
+{
+    UniTiledSource *source;
+    GdkPixbufSimpleAnim *anim;
+    GdkPixbuf *pixbuf;
+    gint width, height;
+
+    source = vnr_tiff_open (request->path, VNR_TIFF_MIN_PIXELS);
+    if (source == NULL)
+        return NULL;
+
+    width = source->width;
+    height = source->height;
+
+    if (request->max_width > 0 && request->max_height > 0)
+        vnr_tools_fit_to_size (&width, &height,
+                               request->max_width, request->max_height);
+    else
+        vnr_tools_fit_to_size (&width, &height, VNR_TIFF_RENDITION_SIZE,
+                               VNR_TIFF_RENDITION_SIZE);
+
+    /* The view zooms no further than 20x; keep 1:1 within reach */
+    if (width * 16 < source->width)
+    {
+        width = source->width / 16;
+        height = (gint64) source->height * width / source->width;
+    }
+
+    pixbuf = uni_tiled_source_render (source, MAX (width, 1), MAX (height, 1),
+                                      request->cancellable);
+    if (pixbuf == NULL)
+    {
+        uni_tiled_source_unref (source);
+        /* Left for another image; don't pass the file on */
+        g_cancellable_set_error_if_cancelled (request->cancellable, error);
+        return NULL;
+    }
+
+    anim = gdk_pixbuf_simple_anim_new (gdk_pixbuf_get_width (pixbuf),
+                                       gdk_pixbuf_get_height (pixbuf), 1);
+    gdk_pixbuf_simple_anim_add_frame (anim, pixbuf);
+    g_object_unref (pixbuf);
+
+    request->tiled = source;
+    request->full_width = source->width;
+    request->full_height = source->height;
+
+    return GDK_PIXBUF_ANIMATION (anim);
+}
+
+static const gchar * const vnr_tiff_mime_types[] = {
+    "image/tiff",
+    NULL
+};
+
+const VnrDecoder vnr_tiff_decoder = {
+    "libtiff",
+    vnr_tiff_mime_types,
+    VNR_DECODER_SCALED | VNR_DECODER_REGION,
+    vnr_tiff_decode
+};
+
+#endif /* HAVE_LIBTIFF */
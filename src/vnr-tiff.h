@@ -0,0 +1,36 @@
+/*
+ * Copyright © 2009-2015 Siyan Panayotov <contact@siyanpanayotov.com>
+ *
+ * This file is part of Viewnior.
+ *
+ * Viewnior is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Viewnior is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Viewnior.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VNR_TIFF_H__
+#define __VNR_TIFF_H__
+
+#include <glib.h>
+#include "uni-tiled-source.h"
+#include "vnr-decoder.h"
+
+G_BEGIN_DECLS
+
+/* Reads huge TIFF images tile by tile */
+extern const VnrDecoder vnr_tiff_decoder;
+
+UniTiledSource* vnr_tiff_open   (const gchar *path,
+                                 gint64 min_pixels);
+
+G_END_DECLS
+#endif /* __VNR_TIFF_H__ */
@@ -31,15 +31,22 @@
 #include "uni-scroll-win.h"
 #include "uni-anim-view.h"
 #include "vnr-tools.h"
+#include "uni-utils.h"
 #include "vnr-file.h"
 #include "vnr-message-area.h"
 #include "vnr-properties-dialog.h"
 #include "vnr-crop.h"
+#include "vnr-loader.h"
+#include "vnr-disk-cache.h"
 #include "uni-exiv2.hpp"
 
 /* Timeout to hide the toolbar in fullscreen mode */
 #define FULLSCREEN_TIMEOUT 1000
 
+/* Steps through the list closer together than this (in ms) are
+ * coalesced, see vnr_window_navigate() */
+#define VNR_WINDOW_SETTLE_TIME 150
+
 G_DEFINE_TYPE (VnrWindow, vnr_window, GTK_TYPE_WINDOW);
 
 static void vnr_window_unfullscreen (VnrWindow *window);
@@ -47,6 +54,13 @@ static void stop_slideshow(VnrWindow *window);
 static void start_slideshow(VnrWindow *window);
 static void restart_slideshow(VnrWindow *window);
 static void allow_slideshow(VnrWindow *window);
+static void vnr_window_cancel_open (VnrWindow *window);
+static gdouble vnr_window_get_reduction (VnrWindow *window);
+static void vnr_window_check_resolution (VnrWindow *window);
+static gboolean vnr_window_ensure_full_image (VnrWindow *window,
+                                              VnrWindowEditFunc edit,
+                                              gint arg);
+static gboolean vnr_window_bake_orientation (VnrWindow *window);
 
 static void leave_fs_cb (GtkButton *button, VnrWindow *window);
 static void toggle_show_next_cb (GtkToggleButton *togglebutton, VnrWindow *window);
@@ -704,11 +718,22 @@ deny_slideshow(VnrWindow *window)
     gtk_widget_set_sensitive(window->toggle_btn, FALSE);
 }
 
+static void rotate_pixbuf(VnrWindow *window, GdkPixbufRotation angle);
+
+static void
+rotate_pixbuf_edit(VnrWindow *window, gint angle)
+{
+    rotate_pixbuf(window, (GdkPixbufRotation) angle);
+}
+
 static void
 rotate_pixbuf(VnrWindow *window, GdkPixbufRotation angle)
 {
     GdkPixbuf *result;
 
+    if(!vnr_window_ensure_full_image(window, rotate_pixbuf_edit, angle))
+        return;
+
     if(!window->cursor_is_hidden)
         gdk_window_set_cursor(GTK_WIDGET(window)->window,
                               gdk_cursor_new(GDK_WATCH));
@@ -770,11 +795,22 @@ rotate_pixbuf(VnrWindow *window, GdkPixbufRotation angle)
                                           G_CALLBACK(save_image_cb));
 }
 
+static void flip_pixbuf(VnrWindow *window, gboolean horizontal);
+
+static void
+flip_pixbuf_edit(VnrWindow *window, gint horizontal)
+{
+    flip_pixbuf(window, horizontal);
+}
+
 static void
 flip_pixbuf(VnrWindow *window, gboolean horizontal)
 {
     GdkPixbuf *result;
 
+    if(!vnr_window_ensure_full_image(window, flip_pixbuf_edit, horizontal))
+        return;
+
     if(!window->cursor_is_hidden)
         gdk_window_set_cursor (GTK_WIDGET(window)->window,
                                gdk_cursor_new(GDK_WATCH));
@@ -928,6 +964,15 @@ save_image_cb (GtkWidget *widget, VnrWindow *window)
     if(window->prefs->behavior_modify == VNR_PREFS_MODIFY_ASK)
         vnr_message_area_hide(VNR_MESSAGE_AREA(window->msg_area));
 
+    /* The view only turns the pixels while drawing; saving them as
+     * stored would lose the turn. The error is shown already. */
+    if(!vnr_window_bake_orientation(window))
+    {
+        if(!window->cursor_is_hidden)
+            gdk_window_set_cursor(GTK_WIDGET(window)->window, gdk_cursor_new(GDK_LEFT_PTR));
+        return;
+    }
+
     /* Store exiv2 metadata to cache, so we can restore it afterwards */
     uni_read_exiv2_to_cache(VNR_FILE(window->file_list->data)->path);
 
@@ -969,6 +1014,15 @@ save_image_cb (GtkWidget *widget, VnrWindow *window)
         return;
     }
 
+    vnr_prefetch_forget(window->prefetch, VNR_FILE(window->file_list->data)->path);
+
+    /* The file no longer matches what was read when it was opened */
+    if(window->current_image != NULL)
+    {
+        vnr_image_unref(window->current_image);
+        window->current_image = NULL;
+    }
+
     if(window->prefs->reload_on_save)
     {
         vnr_window_open(window, FALSE);
@@ -1084,6 +1138,11 @@ window_change_state_cb (GtkWidget * widget, GdkEventWindowState * event, gpointe
 static void
 window_destroy_cb (GtkObject *object, gpointer user_data)
 {
+    vnr_window_cancel_open (VNR_WINDOW(object));
+    vnr_prefetch_free (VNR_WINDOW(object)->prefetch);
+    VNR_WINDOW(object)->prefetch = NULL;
+    vnr_image_cache_free (VNR_WINDOW(object)->image_cache);
+    VNR_WINDOW(object)->image_cache = NULL;
     vnr_window_save_accel_map();
     vnr_prefs_save(VNR_WINDOW(object)->prefs);
 	gtk_main_quit();
@@ -1103,11 +1162,13 @@ zoom_changed_cb (UniImageView *view, VnrWindow *window)
         buf = g_strdup_printf ("%s%s - %i/%i - %i%%", (window->modifications)?"*":"",
                                VNR_FILE(window->file_list->data)->display_name,
                                position, total,
-                               (int)(view->zoom*100.));
+                               (int)(view->zoom*100./vnr_window_get_reduction(window)));
 
         gtk_window_set_title (GTK_WINDOW(window), buf);
         g_free(buf);
     }
+
+    vnr_window_check_resolution(window);
 }
 
 
@@ -1196,7 +1257,10 @@ vnr_window_cmd_zoom_out (GtkAction *action, gpointer user_data)
 static void
 vnr_window_cmd_normal_size (GtkAction *action, gpointer user_data)
 {
-    uni_image_view_set_zoom(UNI_IMAGE_VIEW(VNR_WINDOW(user_data)->view), 1);
+    /* Zooming a reduced image past 1x brings in the full one, which
+     * then ends up at exactly 1x */
+    uni_image_view_set_zoom(UNI_IMAGE_VIEW(VNR_WINDOW(user_data)->view),
+                            vnr_window_get_reduction(VNR_WINDOW(user_data)));
     uni_image_view_set_fitting(UNI_IMAGE_VIEW(VNR_WINDOW(user_data)->view), UNI_FITTING_NONE);
 }
 
@@ -1258,6 +1322,8 @@ vnr_window_cmd_properties (GtkAction *action, VnrWindow *window)
     vnr_properties_dialog_show(VNR_PROPERTIES_DIALOG (window->props_dlg));
 }
 
+/* The image cache checks whether the file changed, so an unchanged file
+ * is not decoded again */
 static void
 vnr_window_cmd_reload (GtkAction *action, VnrWindow *window)
 {
@@ -1610,6 +1676,8 @@ vnr_window_cmd_delete(GtkAction *action, VnrWindow *window)
         {
             GList *next;
 
+            vnr_prefetch_forget(window->prefetch, file_path);
+
             next = g_list_next(window->file_list);
             if(next == NULL)
                 next = g_list_first(window->file_list);
@@ -1672,6 +1740,14 @@ vnr_window_cmd_delete(GtkAction *action, VnrWindow *window)
     }
 }
 
+static void vnr_window_cmd_crop(GtkAction *action, VnrWindow *window);
+
+static void
+vnr_window_crop_edit(VnrWindow *window, gint unused)
+{
+    vnr_window_cmd_crop(NULL, window);
+}
+
 static void
 vnr_window_cmd_crop(GtkAction *action, VnrWindow *window)
 {
@@ -1679,6 +1755,9 @@ vnr_window_cmd_crop(GtkAction *action, VnrWindow *window)
     
     if ( !gtk_action_group_get_sensitive(window->actions_static_image) )
         return;
+
+    if ( !vnr_window_ensure_full_image(window, vnr_window_crop_edit, 0) )
+        return;
 		
     crop = (VnrCrop*) vnr_crop_new (window);
 
@@ -2027,6 +2106,15 @@ vnr_window_init (VnrWindow * window)
     GtkAction *action;
 
     window->writable_format_name = NULL;
+    window->load_cancellable = NULL;
+    window->upgrade_cancellable = NULL;
+    window->upgrade_edit = NULL;
+    window->settle_source = 0;
+    window->last_navigation = 0;
+    window->image_cache = vnr_image_cache_new ();
+    window->prefetch = vnr_prefetch_new (window->image_cache);
+    window->current_image = NULL;
+    window->showing_partial = FALSE;
     window->file_list = NULL;
     window->fs_controls = NULL;
     window->fs_source = NULL;
@@ -2302,34 +2390,353 @@ vnr_window_init (VnrWindow * window)
 /*************************************************************/
 /***** Actions ***********************************************/
 /*************************************************************/
-gboolean
-vnr_window_open (VnrWindow * window, gboolean fit_to_screen)
+static void
+vnr_window_set_busy (VnrWindow *window, gboolean busy)
 {
-    VnrFile *file;
-    GdkPixbufAnimation *pixbuf;
-    GdkPixbufFormat *format;
-    UniFittingMode last_fit_mode;
+    if(window->cursor_is_hidden || !gtk_widget_get_realized(GTK_WIDGET(window)))
+        return;
+
+    gdk_window_set_cursor(GTK_WIDGET(window)->window,
+                          gdk_cursor_new(busy ? GDK_WATCH : GDK_LEFT_PTR));
+    /* This makes the cursor show NOW */
+    gdk_flush();
+}
+
+static void
+vnr_window_cancel_upgrade (VnrWindow *window)
+{
+    if(window->upgrade_cancellable == NULL)
+        return;
+
+    g_cancellable_cancel(window->upgrade_cancellable);
+    g_object_unref(window->upgrade_cancellable);
+    window->upgrade_cancellable = NULL;
+
+    if(window->upgrade_edit != NULL)
+    {
+        window->upgrade_edit = NULL;
+        vnr_window_set_busy(window, FALSE);
+    }
+}
+
+/* Drops the decode started by the last vnr_window_open(), if it is
+ * still running. Its result will never reach the view. */
+static void
+vnr_window_cancel_open (VnrWindow *window)
+{
+    vnr_window_cancel_upgrade(window);
+
+    if(window->settle_source != 0)
+    {
+        g_source_remove(window->settle_source);
+        window->settle_source = 0;
+        vnr_window_set_busy(window, FALSE);
+    }
+
+    if(window->load_cancellable == NULL)
+        return;
+
+    g_cancellable_cancel(window->load_cancellable);
+    g_object_unref(window->load_cancellable);
+    window->load_cancellable = NULL;
+
+    vnr_window_set_busy(window, FALSE);
+}
+
+typedef struct {
+    VnrWindow *window;
+    GCancellable *cancellable;
+    gboolean fit_to_screen;
+} VnrOpenRequest;
+
+static void
+vnr_open_request_free (VnrOpenRequest *request)
+{
+    g_object_unref (request->cancellable);
+    g_object_unref (request->window);
+    g_slice_free (VnrOpenRequest, request);
+}
+
+/* Size a newly opened image may be decoded at, or 0x0 for full size.
+ * Fitted images never get bigger than the monitor. */
+static void
+vnr_window_get_decode_size (VnrWindow *window, gint *width, gint *height)
+{
+    GdkScreen *screen;
+    GdkRectangle monitor;
+    gboolean fits;
+
+    *width = *height = 0;
+
+    if(window->mode != VNR_WINDOW_MODE_NORMAL && window->prefs->fit_on_fullscreen)
+        fits = TRUE;
+    else if(window->prefs->zoom == VNR_PREFS_ZOOM_LAST_USED)
+        fits = UNI_IMAGE_VIEW(window->view)->fitting != UNI_FITTING_NONE;
+    else
+        fits = window->prefs->zoom == VNR_PREFS_ZOOM_SMART
+               || window->prefs->zoom == VNR_PREFS_ZOOM_FIT;
+
+    if(!fits)
+        return;
+
+    screen = gtk_window_get_screen(GTK_WINDOW(window));
+
+    if(gtk_widget_get_realized(GTK_WIDGET(window)))
+    {
+        gdk_screen_get_monitor_geometry(screen,
+                                        gdk_screen_get_monitor_at_window(screen,
+                                            GTK_WIDGET(window)->window),
+                                        &monitor);
+    }
+    else
+    {
+        monitor.width = gdk_screen_get_width(screen);
+        monitor.height = gdk_screen_get_height(screen);
+    }
+
+    *width = monitor.width;
+    *height = monitor.height;
+}
+
+/* Whether the view shows current_image at a reduced size */
+static gboolean
+vnr_window_shows_reduced (VnrWindow *window)
+{
+    VnrImage *image = window->current_image;
+
+    return image != NULL && image->reduced
+           && UNI_IMAGE_VIEW(window->view)->pixbuf != NULL
+           && UNI_IMAGE_VIEW(window->view)->pixbuf
+              == gdk_pixbuf_animation_get_static_image(image->anim);
+}
+
+/* How many times larger the file is than what the view shows */
+static gdouble
+vnr_window_get_reduction (VnrWindow *window)
+{
+    gint view_width;
+
+    if(!vnr_window_shows_reduced(window))
+        return 1.0;
+
+    uni_image_view_get_image_size(UNI_IMAGE_VIEW(window->view), &view_width, NULL);
+    return (gdouble) window->current_image->width / view_width;
+}
+
+/* Swaps a reduced image on screen for its full size decode */
+static void
+vnr_window_replace_image (VnrWindow *window, VnrImage *image)
+{
+    uni_anim_view_replace_anim(UNI_ANIM_VIEW(window->view), image->anim,
+                               image->orientation);
+
+    vnr_image_unref(window->current_image);
+    window->current_image = vnr_image_ref(image);
+
+    if(gtk_widget_get_visible(window->props_dlg))
+        vnr_properties_dialog_update_image(VNR_PROPERTIES_DIALOG(window->props_dlg));
+}
+
+static void
+vnr_window_upgrade_ready_cb (GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+    VnrOpenRequest *request = user_data;
+    VnrWindow *window = request->window;
+    VnrWindowEditFunc edit;
+    VnrImage *image;
     GError *error = NULL;
 
-    if(window->file_list == NULL)
-        return FALSE;
+    image = vnr_loader_load_finish (result, &error);
 
-    file = VNR_FILE(window->file_list->data);
+    if(g_cancellable_is_cancelled (request->cancellable) ||
+       request->cancellable != window->upgrade_cancellable)
+        goto out;
 
-    update_fs_filename_label(window);
+    g_object_unref (window->upgrade_cancellable);
+    window->upgrade_cancellable = NULL;
 
-    pixbuf = gdk_pixbuf_animation_new_from_file (file->path, &error);
+    edit = window->upgrade_edit;
+    window->upgrade_edit = NULL;
+    if(edit != NULL)
+        vnr_window_set_busy (window, FALSE);
 
-    if (error != NULL)
+    if(error != NULL)
     {
         vnr_message_area_show(VNR_MESSAGE_AREA (window->msg_area),
-                              TRUE, error->message, TRUE);
+                              TRUE, error->message, FALSE);
+        goto out;
+    }
 
-        if(gtk_widget_get_visible(window->props_dlg))
-            vnr_properties_dialog_clear(VNR_PROPERTIES_DIALOG(window->props_dlg));
+    if(vnr_window_shows_reduced (window))
+        vnr_window_replace_image (window, image);
+
+    if(edit != NULL)
+        edit (window, window->upgrade_edit_arg);
+
+out:
+    if(image != NULL)
+        vnr_image_unref (image);
+    g_clear_error (&error);
+    vnr_open_request_free (request);
+}
+
+/* Starts decoding the reduced image on screen at full size, unless
+ * that is under way already. */
+static void
+vnr_window_start_upgrade (VnrWindow *window)
+{
+    VnrOpenRequest *request;
+
+    if(window->upgrade_cancellable != NULL)
+        return;
+
+    window->upgrade_cancellable = g_cancellable_new ();
+
+    request = g_slice_new (VnrOpenRequest);
+    request->window = g_object_ref (window);
+    request->cancellable = g_object_ref (window->upgrade_cancellable);
+    request->fit_to_screen = FALSE;
+
+    vnr_loader_load_async (window->current_image->path, 0, 0,
+                           window->upgrade_cancellable,
+                           NULL, NULL, NULL,
+                           vnr_window_upgrade_ready_cb, request);
+}
+
+/* Starts decoding the full image once a reduced one is zoomed past
+ * the size it was decoded at. */
+static void
+vnr_window_check_resolution (VnrWindow *window)
+{
+    /* Tiled images are drawn from their tiles instead */
+    if(UNI_IMAGE_VIEW(window->view)->zoom <= 1.0
+       || !vnr_window_shows_reduced(window)
+       || window->current_image->tiled != NULL)
+        return;
+
+    vnr_window_start_upgrade (window);
+}
+
+/* The view turns rotated photos while drawing. Edits and saving work
+ * on the pixels themselves, so those get turned for good first. */
+static gboolean
+vnr_window_bake_orientation (VnrWindow *window)
+{
+    UniImageView *view = UNI_IMAGE_VIEW(window->view);
+    GdkPixbufSimpleAnim *s_anim;
+    GdkPixbuf *turned;
+
+    if(view->pixbuf == NULL || view->orientation == 1)
+        return TRUE;
+
+    turned = uni_pixbuf_apply_orientation(view->pixbuf, view->orientation);
+    if(turned == NULL)
+    {
+        vnr_message_area_show(VNR_MESSAGE_AREA(window->msg_area),
+                              TRUE, _("Not enough virtual memory."),
+                              FALSE);
         return FALSE;
     }
 
+    s_anim = gdk_pixbuf_simple_anim_new (gdk_pixbuf_get_width(turned),
+                                         gdk_pixbuf_get_height(turned),
+                                         -1);
+    gdk_pixbuf_simple_anim_add_frame(s_anim, turned);
+    g_object_unref(turned);
+
+    uni_anim_view_replace_anim(UNI_ANIM_VIEW(window->view),
+                               GDK_PIXBUF_ANIMATION(s_anim), 1);
+    g_object_unref(s_anim);
+    return TRUE;
+}
+
+/* Edits work on the pixels in the view and get saved over the file,
+ * so they need the full image. Returns TRUE if the image can be edited
+ * right away. Otherwise the full image is decoded in the background and
+ * @edit is called again with @arg once it is on screen; errors are
+ * shown in the message area. An edit that comes in while another one
+ * waits is dropped. */
+static gboolean
+vnr_window_ensure_full_image (VnrWindow *window, VnrWindowEditFunc edit, gint arg)
+{
+    if(!vnr_window_shows_reduced(window))
+        return vnr_window_bake_orientation (window);
+
+    if(window->current_image->tiled != NULL)
+    {
+        vnr_message_area_show(VNR_MESSAGE_AREA (window->msg_area), TRUE,
+                              _("The image is too large to be edited."), FALSE);
+        return FALSE;
+    }
+
+    if(window->upgrade_edit != NULL)
+        return FALSE;
+
+    window->upgrade_edit = edit;
+    window->upgrade_edit_arg = arg;
+    vnr_window_set_busy (window, TRUE);
+    vnr_window_start_upgrade (window);
+    return FALSE;
+}
+
+/* Sets the zoom a newly shown image starts with. */
+static void
+vnr_window_apply_zoom_mode (VnrWindow *window, UniFittingMode last_fit_mode)
+{
+    if(window->mode != VNR_WINDOW_MODE_NORMAL && window->prefs->fit_on_fullscreen) 
+    {
+		uni_image_view_set_zoom_mode (UNI_IMAGE_VIEW(window->view), VNR_PREFS_ZOOM_FIT);
+    } 
+    else if(window->prefs->zoom == VNR_PREFS_ZOOM_LAST_USED )
+    {
+		uni_image_view_set_fitting (UNI_IMAGE_VIEW(window->view), last_fit_mode);
+		zoom_changed_cb(UNI_IMAGE_VIEW(window->view), window);
+    }
+    else
+    {
+		uni_image_view_set_zoom_mode (UNI_IMAGE_VIEW(window->view), window->prefs->zoom);
+    }
+}
+
+/* Shows an image that is still being decoded, and refreshes the parts
+ * of it that got decoded since. Once the decode is done,
+ * vnr_window_show_image() replaces it with the finished image. */
+static void
+vnr_window_open_progress_cb (GdkPixbuf *pixbuf,
+                             gint x, gint y, gint width, gint height,
+                             gpointer user_data)
+{
+    VnrOpenRequest *request = user_data;
+    VnrWindow *window = request->window;
+    UniImageView *view = UNI_IMAGE_VIEW(window->view);
+    GdkRectangle area = { x, y, width, height };
+    UniFittingMode last_fit_mode;
+
+    if(request->cancellable != window->load_cancellable)
+        return;
+
+    if(view->pixbuf == pixbuf)
+    {
+        uni_image_view_damage_pixels (view, &area);
+        return;
+    }
+
+    if(vnr_message_area_is_visible(VNR_MESSAGE_AREA(window->msg_area)))
+        vnr_message_area_hide(VNR_MESSAGE_AREA(window->msg_area));
+
+    last_fit_mode = view->fitting;
+
+    uni_anim_view_set_anim (UNI_ANIM_VIEW (window->view), NULL);
+    uni_image_view_set_pixbuf (view, pixbuf, TRUE);
+    vnr_window_apply_zoom_mode (window, last_fit_mode);
+    window->showing_partial = TRUE;
+}
+
+static void
+vnr_window_show_image (VnrWindow *window, VnrImage *image, gboolean fit_to_screen)
+{
+    UniFittingMode last_fit_mode;
+
     if(vnr_message_area_is_visible(VNR_MESSAGE_AREA(window->msg_area)))
     {
         vnr_message_area_hide(VNR_MESSAGE_AREA(window->msg_area));
@@ -2340,17 +2747,15 @@ vnr_window_open (VnrWindow * window, gboolean fit_to_screen)
     gtk_action_group_set_sensitive(window->action_wallpaper, TRUE);
 #endif /* HAVE_WALLPAPER */
 
-    format = gdk_pixbuf_get_file_info (file->path, NULL, NULL);
-
     g_free(window->writable_format_name);
-    if(gdk_pixbuf_format_is_writable (format))
-        window->writable_format_name = gdk_pixbuf_format_get_name (format);
-    else
-        window->writable_format_name = NULL;
+    window->writable_format_name = g_strdup(image->writable_format_name);
+
+    if(window->current_image != NULL)
+        vnr_image_unref(window->current_image);
+    window->current_image = vnr_image_ref(image);
 
-    vnr_tools_apply_embedded_orientation (&pixbuf);
-    window->current_image_width = gdk_pixbuf_animation_get_width (pixbuf);
-    window->current_image_height = gdk_pixbuf_animation_get_height (pixbuf);
+    window->current_image_width = image->width;
+    window->current_image_height = image->height;
     window->modifications = 0;
 
     if(fit_to_screen)
@@ -2367,25 +2772,25 @@ vnr_window_open (VnrWindow * window, gboolean fit_to_screen)
     
     last_fit_mode = UNI_IMAGE_VIEW(window->view)->fitting;
     
+    /* Swap the finished image in for the partial one or the embedded
+     * preview in place, so the view doesn't jump back to the top left */
+    if ( window->showing_partial && gdk_pixbuf_animation_is_static_image (image->anim) )
+    {
+        uni_anim_view_replace_anim (UNI_ANIM_VIEW (window->view), image->anim,
+                                    image->orientation);
+        gtk_action_group_set_sensitive(window->actions_static_image, TRUE);
+    }
     /* Return TRUE if the image is static */
-    if ( uni_anim_view_set_anim (UNI_ANIM_VIEW (window->view), pixbuf) )
+    else if ( uni_anim_view_set_anim (UNI_ANIM_VIEW (window->view), image->anim) )
         gtk_action_group_set_sensitive(window->actions_static_image, TRUE);
     else
         gtk_action_group_set_sensitive(window->actions_static_image, FALSE);
 
-    if(window->mode != VNR_WINDOW_MODE_NORMAL && window->prefs->fit_on_fullscreen) 
-    {
-		uni_image_view_set_zoom_mode (UNI_IMAGE_VIEW(window->view), VNR_PREFS_ZOOM_FIT);
-    } 
-    else if(window->prefs->zoom == VNR_PREFS_ZOOM_LAST_USED )
-    {
-		uni_image_view_set_fitting (UNI_IMAGE_VIEW(window->view), last_fit_mode);
-		zoom_changed_cb(UNI_IMAGE_VIEW(window->view), window);
-    }
-    else
-    {
-		uni_image_view_set_zoom_mode (UNI_IMAGE_VIEW(window->view), window->prefs->zoom);
-    }
+    uni_image_view_set_orientation (UNI_IMAGE_VIEW (window->view), image->orientation);
+    uni_image_view_set_tiled_source (UNI_IMAGE_VIEW (window->view), image->tiled);
+
+    vnr_window_apply_zoom_mode (window, last_fit_mode);
+    window->showing_partial = FALSE;
 	
 	if ( window->prefs->auto_resize ) {
 	    vnr_window_cmd_resize(NULL, window);
@@ -2395,8 +2800,162 @@ vnr_window_open (VnrWindow * window, gboolean fit_to_screen)
         vnr_properties_dialog_update(VNR_PROPERTIES_DIALOG(window->props_dlg));
     
     vnr_window_update_openwith_menu (window);
+}
 
-    g_object_unref(pixbuf);
+static void
+vnr_window_open_ready_cb (GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+    VnrOpenRequest *request = user_data;
+    VnrWindow *window = request->window;
+    VnrImage *image;
+    GError *error = NULL;
+
+    image = vnr_prefetch_load_finish (window->prefetch, result, &error);
+
+    /* Superseded by a newer vnr_window_open() or by vnr_window_close() */
+    if(g_cancellable_is_cancelled (request->cancellable) ||
+       request->cancellable != window->load_cancellable)
+    {
+        if(image != NULL)
+            vnr_image_unref (image);
+        g_clear_error (&error);
+        goto out;
+    }
+
+    g_object_unref (window->load_cancellable);
+    window->load_cancellable = NULL;
+    vnr_window_set_busy (window, FALSE);
+
+    if (error != NULL)
+    {
+        vnr_message_area_show(VNR_MESSAGE_AREA (window->msg_area),
+                              TRUE, error->message, TRUE);
+
+        if(gtk_widget_get_visible(window->props_dlg))
+            vnr_properties_dialog_clear(VNR_PROPERTIES_DIALOG(window->props_dlg));
+        g_error_free (error);
+        goto out;
+    }
+
+    vnr_window_show_image (window, image, request->fit_to_screen);
+    vnr_image_unref (image);
+
+out:
+    vnr_open_request_free (request);
+}
+
+/* Called when the current file of the list is no longer the one on
+ * screen. Stops whatever was being done for the old one. */
+static void
+vnr_window_leave_image (VnrWindow *window)
+{
+    update_fs_filename_label(window);
+
+    vnr_window_cancel_open (window);
+    window->showing_partial = FALSE;
+
+    /* Pending modifications belong to the image on screen, which is
+     * no longer the current file. Make sure they can't be saved over
+     * the file that is being loaded. */
+    if(window->modifications)
+    {
+        window->modifications = 0;
+        vnr_message_area_hide(VNR_MESSAGE_AREA(window->msg_area));
+    }
+    gtk_action_group_set_sensitive(window->action_save, FALSE);
+    gtk_action_group_set_sensitive(window->actions_static_image, FALSE);
+}
+
+static gboolean
+vnr_window_settle_cb (VnrWindow *window)
+{
+    window->settle_source = 0;
+    vnr_window_open (window, FALSE);
+    return FALSE;
+}
+
+/* Opens the current file after a step through the list. Steps that
+ * come in quick succession, like a held down arrow key, are taken as
+ * one: images that are decoded already are shown on the way, the
+ * others are skipped, and only the file the user settles on is
+ * decoded. */
+static void
+vnr_window_navigate (VnrWindow *window)
+{
+    VnrFile *file = VNR_FILE(window->file_list->data);
+    gint64 now = g_get_monotonic_time ();
+    gboolean burst;
+    gint position, total;
+    gchar *title;
+
+    burst = now - window->last_navigation < VNR_WINDOW_SETTLE_TIME * 1000;
+    window->last_navigation = now;
+
+    if(!burst || vnr_prefetch_is_ready (window->prefetch, file->path))
+    {
+        vnr_window_open (window, FALSE);
+        return;
+    }
+
+    /* Skipped; the old image stays on screen, so at least say where
+     * in the list we are. Re-centring the prefetcher cancels the
+     * decodes of the files left behind, including the one the last
+     * open was waiting for. */
+    vnr_window_leave_image (window);
+    vnr_prefetch_set_position (window->prefetch, window->file_list);
+
+    get_position_of_element_in_list(window->file_list, &position, &total);
+    title = g_strdup_printf ("%s - %i/%i", file->display_name, position, total);
+    gtk_window_set_title (GTK_WINDOW (window), title);
+    g_free (title);
+
+    vnr_window_set_busy (window, TRUE);
+    window->settle_source = g_timeout_add (VNR_WINDOW_SETTLE_TIME,
+                                           (GSourceFunc) vnr_window_settle_cb,
+                                           window);
+}
+
+/* Starts decoding the current file of the list on a worker thread,
+ * unless the prefetcher has it already. The previous image stays on
+ * screen, and the window keeps redrawing, until the new one is ready.
+ * Any decode still running from an earlier call is cancelled, and the
+ * prefetcher is re-centred on the new position. */
+gboolean
+vnr_window_open (VnrWindow * window, gboolean fit_to_screen)
+{
+    VnrFile *file;
+    VnrOpenRequest *request, *progress;
+    gint width, height;
+
+    if(window->file_list == NULL)
+        return FALSE;
+
+    file = VNR_FILE(window->file_list->data);
+
+    vnr_window_leave_image (window);
+    window->load_cancellable = g_cancellable_new ();
+
+    vnr_window_set_busy (window, TRUE);
+
+    request = g_slice_new (VnrOpenRequest);
+    request->window = g_object_ref (window);
+    request->cancellable = g_object_ref (window->load_cancellable);
+    request->fit_to_screen = fit_to_screen;
+
+    progress = g_slice_new (VnrOpenRequest);
+    progress->window = g_object_ref (window);
+    progress->cancellable = g_object_ref (window->load_cancellable);
+    progress->fit_to_screen = fit_to_screen;
+
+    vnr_window_get_decode_size (window, &width, &height);
+    vnr_prefetch_set_target_size (window->prefetch, width, height);
+
+    vnr_prefetch_load_async (window->prefetch, file->path,
+                             window->load_cancellable,
+                             vnr_window_open_progress_cb, progress,
+                             (GDestroyNotify) vnr_open_request_free,
+                             vnr_window_open_ready_cb, request);
+    vnr_prefetch_set_position (window->prefetch, window->file_list);
     return TRUE;
 }
 
@@ -2444,25 +3003,23 @@ vnr_window_open_from_list(VnrWindow *window, GSList *uri_list)
     else
     {
         vnr_window_set_list(window, file_list, TRUE);
-        if(!window->cursor_is_hidden)
-            gdk_window_set_cursor(GTK_WIDGET(window)->window,
-                                  gdk_cursor_new(GDK_WATCH));
-        /* This makes the cursor show NOW */
-        gdk_flush();
-
         vnr_window_close(window);
         vnr_window_open(window, FALSE);
-        if(!window->cursor_is_hidden)
-            gdk_window_set_cursor(GTK_WIDGET(window)->window,
-                                  gdk_cursor_new(GDK_LEFT_PTR));
     }
 }
 
 void
 vnr_window_close(VnrWindow *window)
 {
+    vnr_window_cancel_open (window);
+    if(window->current_image != NULL)
+    {
+        vnr_image_unref(window->current_image);
+        window->current_image = NULL;
+    }
     gtk_window_set_title (GTK_WINDOW (window), "Viewnior");
     uni_anim_view_set_anim (UNI_ANIM_VIEW (window->view), NULL);
+    window->showing_partial = FALSE;
     gtk_action_group_set_sensitive(window->actions_image, FALSE);
     gtk_action_group_set_sensitive(window->action_wallpaper, FALSE);
     gtk_action_group_set_sensitive(window->actions_static_image, FALSE);
@@ -2506,16 +3063,7 @@ vnr_window_next (VnrWindow *window, gboolean rem_timeout){
 
     window->file_list = next;
 
-    if(!window->cursor_is_hidden)
-        gdk_window_set_cursor(GTK_WIDGET(window)->window,
-                              gdk_cursor_new(GDK_WATCH));
-    /* This makes the cursor show NOW */
-    gdk_flush();
-
-    vnr_window_open(window, FALSE);
-    if(!window->cursor_is_hidden)
-        gdk_window_set_cursor(GTK_WIDGET(window)->window,
-                              gdk_cursor_new(GDK_LEFT_PTR));
+    vnr_window_navigate(window);
 
     if(window->mode == VNR_WINDOW_MODE_SLIDESHOW && rem_timeout)
         window->ss_source_tag = g_timeout_add_seconds (window->ss_timeout,
@@ -2545,16 +3093,7 @@ vnr_window_prev (VnrWindow *window){
 
     window->file_list = prev;
 
-    if(!window->cursor_is_hidden)
-        gdk_window_set_cursor(GTK_WIDGET(window)->window,
-                              gdk_cursor_new(GDK_WATCH));
-    /* This makes the cursor show NOW */
-    gdk_flush();
-
-    vnr_window_open(window, FALSE);
-    if(!window->cursor_is_hidden)
-        gdk_window_set_cursor(GTK_WIDGET(window)->window,
-                              gdk_cursor_new(GDK_LEFT_PTR));
+    vnr_window_navigate(window);
 
     if(window->mode == VNR_WINDOW_MODE_SLIDESHOW)
         window->ss_source_tag = g_timeout_add_seconds (window->ss_timeout,
@@ -2577,16 +3116,7 @@ vnr_window_first (VnrWindow *window){
 
     window->file_list = prev;
 
-    if(!window->cursor_is_hidden)
-        gdk_window_set_cursor(GTK_WIDGET(window)->window,
-                              gdk_cursor_new(GDK_WATCH));
-    /* This makes the cursor show NOW */
-    gdk_flush();
-
-    vnr_window_open(window, FALSE);
-    if(!window->cursor_is_hidden)
-        gdk_window_set_cursor(GTK_WIDGET(window)->window,
-                              gdk_cursor_new(GDK_LEFT_PTR));
+    vnr_window_navigate(window);
     return TRUE;
 }
 
@@ -2603,16 +3133,7 @@ vnr_window_last (VnrWindow *window){
 
     window->file_list = prev;
 
-    if(!window->cursor_is_hidden)
-        gdk_window_set_cursor(GTK_WIDGET(window)->window,
-                              gdk_cursor_new(GDK_WATCH));
-    /* This makes the cursor show NOW */
-    gdk_flush();
-
-    vnr_window_open(window, FALSE);
-    if(!window->cursor_is_hidden)
-        gdk_window_set_cursor(GTK_WIDGET(window)->window,
-                              gdk_cursor_new(GDK_LEFT_PTR));
+    vnr_window_navigate(window);
     return TRUE;
 }
 
@@ -2635,6 +3156,14 @@ vnr_window_apply_preferences (VnrWindow *window)
     {
         gtk_spin_button_set_value(GTK_SPIN_BUTTON(window->ss_timeout_widget), (gdouble) window->prefs->slideshow_timeout);
     }
+
+    vnr_prefetch_set_limits(window->prefetch,
+                            window->prefs->prefetch_next,
+                            window->prefs->prefetch_previous,
+                            (gsize) MAX(window->prefs->prefetch_memory, 0) * 1024 * 1024);
+    vnr_image_cache_set_budget(window->image_cache,
+                               (gsize) MAX(window->prefs->image_cache_memory, 0) * 1024 * 1024);
+    vnr_disk_cache_set_limit((gsize) MAX(window->prefs->disk_cache_size, 0) * 1024 * 1024);
 }
 
 void
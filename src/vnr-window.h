@@ -24,12 +24,17 @@
 #include <glib-object.h>
 #include <gtk/gtk.h>
 #include "vnr-prefs.h"
+#include "vnr-prefetch.h"
 
 G_BEGIN_DECLS
 
 typedef struct _VnrWindow VnrWindow;
 typedef struct _VnrWindowClass VnrWindowClass;
 
+/* An edit of the image on screen, put off until it is decoded at full
+ * size. See vnr_window_ensure_full_image(). */
+typedef void (*VnrWindowEditFunc) (VnrWindow *window, gint arg);
+
 #define VNR_TYPE_WINDOW             (vnr_window_get_type ())
 #define VNR_WINDOW(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), VNR_TYPE_WINDOW, VnrWindow))
 #define VNR_WINDOW_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass),  VNR_TYPE_WINDOW, VnrWindowClass))
@@ -82,6 +87,32 @@ struct _VnrWindow {
     gint max_height;
     gchar *writable_format_name;
 
+    /* Cancels the decode started by the last vnr_window_open() */
+    GCancellable *load_cancellable;
+
+    /* Cancels the full size decode of a reduced image */
+    GCancellable *upgrade_cancellable;
+
+    /* Edit to apply once that decode is done, or %NULL */
+    VnrWindowEditFunc upgrade_edit;
+    gint upgrade_edit_arg;
+
+    /* Opens the current file once stepping through the list settles */
+    guint settle_source;
+    gint64 last_navigation;
+
+    /* Keeps the neighbours of the current file decoded */
+    VnrPrefetch *prefetch;
+
+    /* Recently shown images, shared with the prefetcher */
+    VnrImageCache *image_cache;
+
+    /* The image on screen, along with the contents of its file */
+    VnrImage *current_image;
+
+    /* The view shows a partly decoded image or an embedded preview */
+    gboolean showing_partial;
+
     gint current_image_height;
     gint current_image_width;
 